@@ -0,0 +1,9 @@
+#pragma once
+
+// Stands in for the SDK header so the proxy can share the payload layouts
+// in src/ without the Pebble SDK.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
@@ -0,0 +1,48 @@
+#include "geohash.h"
+
+#include <string.h>
+
+static const char BASE32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+// out needs room for precision + 1 characters.
+void geohash_encode(double latitude, double longitude, int precision, char* out) {
+  double range[2][2] = { { -90, 90 }, { -180, 180 } };
+  double point[2] = { latitude, longitude };
+  int axis = 1;  // longitude first
+  for (int i = 0; i < precision; i++) {
+    int digit = 0;
+    for (int bit = 0; bit < 5; bit++) {
+      double mid = (range[axis][0] + range[axis][1]) / 2;
+      digit <<= 1;
+      if (point[axis] >= mid) {
+        digit |= 1;
+        range[axis][0] = mid;
+      } else {
+        range[axis][1] = mid;
+      }
+      axis ^= 1;
+    }
+    out[i] = BASE32[digit];
+  }
+  out[precision] = '\0';
+}
+
+void geohash_centre(const char* hash, double* latitude, double* longitude) {
+  double range[2][2] = { { -90, 90 }, { -180, 180 } };
+  int axis = 1;
+  for (const char* c = hash; *c; c++) {
+    const char* found = strchr(BASE32, *c);
+    int digit = found ? found - BASE32 : 0;
+    for (int bit = 4; bit >= 0; bit--) {
+      double mid = (range[axis][0] + range[axis][1]) / 2;
+      if (digit & (1 << bit)) {
+        range[axis][0] = mid;
+      } else {
+        range[axis][1] = mid;
+      }
+      axis ^= 1;
+    }
+  }
+  *latitude = (range[0][0] + range[0][1]) / 2;
+  *longitude = (range[1][0] + range[1][1]) / 2;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+
+// Forecasts are cached per geohash tile; precision 5 gives tiles of about
+// 5 km, close to the 0.05 degree grid the phone already snaps to.
+#define GEOHASH_MAX_PRECISION 12
+
+void geohash_encode(double latitude, double longitude, int precision, char* out);
+void geohash_centre(const char* hash, double* latitude, double* longitude);
@@ -0,0 +1,146 @@
+#include "json_scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* skip_space(const char* at, const char* end) {
+  while (at < end && (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n')) {
+    at++;
+  }
+  return at;
+}
+
+// Just past the object, array, string or bare value starting at "start".
+static const char* value_end(const char* start, const char* end) {
+  int depth = 0;
+  bool in_string = false;
+  for (const char* at = start; at < end; at++) {
+    char c = *at;
+    if (in_string) {
+      if (c == '\\') {
+        at++;
+      } else if (c == '"') {
+        in_string = false;
+        if (depth == 0) {
+          return at + 1;
+        }
+      }
+    } else if (c == '"') {
+      in_string = true;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (--depth <= 0) {
+        return depth == 0 ? at + 1 : at;
+      }
+    } else if (depth == 0 && (c == ',' || c == ' ' || c == '\n' || c == '\r' || c == '\t')) {
+      return at;
+    }
+  }
+  return end;
+}
+
+bool json_find(JsonSpan within, const char* key, JsonSpan* value) {
+  char marker[64];
+  int length = snprintf(marker, sizeof(marker), "\"%s\":", key);
+  if (length < 0 || length >= (int) sizeof(marker)) {
+    return false;
+  }
+  for (const char* at = within.start; at + length <= within.end; at++) {
+    if (memcmp(at, marker, length) == 0) {
+      value->start = skip_space(at + length, within.end);
+      value->end = value_end(value->start, within.end);
+      return value->start < value->end;
+    }
+  }
+  return false;
+}
+
+bool json_number(JsonSpan within, const char* key, double* number) {
+  JsonSpan value;
+  if (!json_find(within, key, &value)) {
+    return false;
+  }
+  char text[32];
+  size_t length = value.end - value.start;
+  if (length == 0 || length >= sizeof(text)) {
+    return false;
+  }
+  memcpy(text, value.start, length);
+  text[length] = '\0';
+  char* parsed_to;
+  *number = strtod(text, &parsed_to);
+  return parsed_to == text + length;
+}
+
+static size_t put_utf8(char* out, unsigned code) {
+  if (code < 0x80) {
+    out[0] = code;
+    return 1;
+  }
+  if (code < 0x800) {
+    out[0] = 0xc0 | (code >> 6);
+    out[1] = 0x80 | (code & 0x3f);
+    return 2;
+  }
+  out[0] = 0xe0 | (code >> 12);
+  out[1] = 0x80 | ((code >> 6) & 0x3f);
+  out[2] = 0x80 | (code & 0x3f);
+  return 3;
+}
+
+// Unescapes into out, truncating to fit. Surrogate pairs aren't joined;
+// forecast summaries don't use them.
+bool json_string(JsonSpan within, const char* key, char* out, size_t size) {
+  JsonSpan value;
+  if (size == 0 || !json_find(within, key, &value) || *value.start != '"') {
+    return false;
+  }
+  size_t used = 0;
+  for (const char* at = value.start + 1; at < value.end - 1 && used + 3 < size; at++) {
+    if (*at != '\\') {
+      out[used++] = *at;
+      continue;
+    }
+    char c = *++at;
+    switch (c) {
+      case 'n': out[used++] = '\n'; break;
+      case 't': out[used++] = '\t'; break;
+      case 'r': out[used++] = '\r'; break;
+      case 'b': out[used++] = '\b'; break;
+      case 'f': out[used++] = '\f'; break;
+      case 'u': {
+        char hex[5] = { 0 };
+        if (value.end - at < 5) {
+          return false;
+        }
+        memcpy(hex, at + 1, 4);
+        used += put_utf8(&out[used], (unsigned) strtoul(hex, NULL, 16));
+        at += 4;
+        break;
+      }
+      default: out[used++] = c; break;
+    }
+  }
+  out[used] = '\0';
+  return true;
+}
+
+// Steps through the objects of an array; *cursor starts as NULL.
+bool json_next_object(JsonSpan array, const char** cursor, JsonSpan* object) {
+  const char* at = *cursor ? *cursor : array.start + 1;
+  while (at < array.end && *at != '{') {
+    if (*at == ']') {
+      return false;
+    }
+    at++;
+  }
+  if (at >= array.end) {
+    return false;
+  }
+  object->start = at;
+  object->end = value_end(at, array.end);
+  *cursor = object->end;
+  return true;
+}
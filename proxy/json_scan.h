@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Just enough JSON to pull fields out of a forecast without building a tree,
+// like the projection parser in pebble-js-app.js. Keys are matched anywhere
+// inside the span, so search the smallest object that holds them.
+typedef struct {
+  const char* start;
+  const char* end;
+} JsonSpan;
+
+bool json_find(JsonSpan within, const char* key, JsonSpan* value);
+bool json_number(JsonSpan within, const char* key, double* number);
+bool json_string(JsonSpan within, const char* key, char* out, size_t size);
+bool json_next_object(JsonSpan array, const char** cursor, JsonSpan* object);
@@ -0,0 +1,465 @@
+// Simulates a fleet of watches polling the proxy, to size a hosted backend.
+//
+//   TIDEY_FIXTURE=tests/fixtures/forecast.json TIDEY_TTL=15 ./tidey_proxy 8080 &
+//   ./loadgen -n 5000 -m 120 -x 60
+//
+// Each watch sits somewhere around one of a handful of cities, in that
+// city's time zone, and asks on the same local-time boundaries as
+// weather_poll_due(): every ten minutes by default, or every six hours with
+// -c 360 once the watch has forecast hours in hand. A poll goes through the
+// phone's own 15-minute cache for its 0.05° grid cell first, as
+// pebble-js-app.js does, and only a miss turns into a request for the cell's
+// centre.
+//
+// Time runs -x times faster than real, so scale the proxy's TIDEY_TTL down
+// by the same factor (900 s at -x 60 is 15 s) to keep its cache honest.
+// Latencies are real, measured per request from connect to close, but the
+// speed-up squeezes the few seconds' spread of each on-the-minute herd too,
+// so they err on the pessimistic side as -x grows.
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GRID_DEGREES 0.05
+#define PHONE_CACHE_SECONDS (15 * 60)
+// Tick to phone to request: the watch wakes on the minute, the phone takes
+// a moment to get a fix and make the call.
+#define PHONE_LAG_MAX_SECONDS 4
+#define RESPONSE_MAX 4096
+
+typedef struct {
+  const char* name;
+  double latitude;
+  double longitude;
+  int utc_offset_minutes;
+} City;
+
+// Zones with half- and quarter-hour offsets are in on purpose, they are the
+// only watches that don't all poll in the same minute.
+static const City s_cities[] = {
+  { "London", 51.51, -0.13, 0 },
+  { "Dover", 51.13, 1.31, 0 },
+  { "Paris", 48.86, 2.35, 60 },
+  { "Berlin", 52.52, 13.40, 60 },
+  { "Athens", 37.98, 23.73, 120 },
+  { "Moscow", 55.76, 37.62, 180 },
+  { "Tehran", 35.69, 51.39, 210 },
+  { "Dubai", 25.20, 55.27, 240 },
+  { "Mumbai", 19.08, 72.88, 330 },
+  { "Kathmandu", 27.72, 85.32, 345 },
+  { "Singapore", 1.35, 103.82, 480 },
+  { "Tokyo", 35.68, 139.69, 540 },
+  { "Adelaide", -34.93, 138.60, 570 },
+  { "Sydney", -33.87, 151.21, 600 },
+  { "Auckland", -36.85, 174.76, 720 },
+  { "Honolulu", 21.31, -157.86, -600 },
+  { "San Francisco", 37.77, -122.42, -480 },
+  { "Denver", 39.74, -104.99, -420 },
+  { "Chicago", 41.88, -87.63, -360 },
+  { "New York", 40.71, -74.01, -300 },
+  { "St. John's", 47.56, -52.71, -210 },
+  { "Sao Paulo", -23.55, -46.63, -180 },
+};
+#define CITY_COUNT (int) (sizeof(s_cities) / sizeof(s_cities[0]))
+
+typedef struct {
+  double latitude;
+  double longitude;
+  int utc_offset_minutes;
+  int lag_seconds;
+  time_t next_poll;        // simulated time
+  long cached_row;         // phone's forecast cache, one cell
+  long cached_column;
+  time_t cached_at;
+} Watch;
+
+typedef struct {
+  uint32_t* latencies_us;
+  size_t count;
+  size_t capacity;
+  unsigned errors;
+  unsigned phone_hits;
+  size_t bytes;
+  double worst_lag;        // real seconds a poll started after it was due
+} WorkerStats;
+
+static struct {
+  const char* host;
+  int port;
+  const char* token;
+  int cadence_minutes;
+  double speedup;
+  time_t sim_start;
+  time_t sim_end;
+  double real_start;
+} s_run;
+
+static Watch* s_watches;
+// Min-heap of watch indices by next_poll.
+static int* s_heap;
+static int s_heap_size;
+static unsigned* s_per_minute;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_pushed = PTHREAD_COND_INITIALIZER;
+
+static double real_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double monotonic_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double real_time_of(time_t sim_time) {
+  return s_run.real_start + (sim_time - s_run.sim_start) / s_run.speedup;
+}
+
+//------SCHEDULE------
+
+// The first poll after `after`, on the watch's local cadence boundary.
+static time_t next_poll_after(const Watch* watch, time_t after) {
+  time_t step = s_run.cadence_minutes * 60;
+  time_t offset = watch->utc_offset_minutes * 60;
+  time_t local = after - watch->lag_seconds + offset;
+  time_t boundary = (local / step + 1) * step;
+  return boundary - offset + watch->lag_seconds;
+}
+
+static bool earlier(int a, int b) {
+  return s_watches[s_heap[a]].next_poll < s_watches[s_heap[b]].next_poll;
+}
+
+static void swap(int a, int b) {
+  int t = s_heap[a];
+  s_heap[a] = s_heap[b];
+  s_heap[b] = t;
+}
+
+static void heap_push(int watch) {
+  int i = s_heap_size++;
+  s_heap[i] = watch;
+  while (i > 0 && earlier(i, (i - 1) / 2)) {
+    swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static int heap_pop(void) {
+  int top = s_heap[0];
+  s_heap[0] = s_heap[--s_heap_size];
+  for (int i = 0;;) {
+    int child = 2 * i + 1;
+    if (child >= s_heap_size) {
+      break;
+    }
+    if (child + 1 < s_heap_size && earlier(child + 1, child)) {
+      child++;
+    }
+    if (!earlier(child, i)) {
+      break;
+    }
+    swap(i, child);
+    i = child;
+  }
+  return top;
+}
+
+//------HTTP------
+
+static int http_get(const char* path, char* response, size_t size) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = htons(s_run.port) };
+  if (fd < 0) {
+    return -1;
+  }
+  if (inet_pton(AF_INET, s_run.host, &address.sin_addr) != 1 ||
+      connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  char request[512];
+  int length = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\n\r\n", path);
+  if (write(fd, request, length) != length) {
+    close(fd);
+    return -1;
+  }
+  size_t used = 0;
+  ssize_t got;
+  while ((got = read(fd, response + used, size - 1 - used)) > 0) {
+    used += got;
+    if (used == size - 1) {
+      break;
+    }
+  }
+  close(fd);
+  response[used] = '\0';
+  return (int) used;
+}
+
+static bool http_ok(const char* response) {
+  return strncmp(response, "HTTP/1.0 200", 12) == 0 || strncmp(response, "HTTP/1.1 200", 12) == 0;
+}
+
+// encodeURIComponent(), near enough for a token.
+static void uri_encode(const char* text, char* out, size_t size) {
+  static const char hex[] = "0123456789ABCDEF";
+  size_t used = 0;
+  for (; *text && used + 4 < size; text++) {
+    unsigned char c = *text;
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || strchr("-_.!~*'()", c)) {
+      out[used++] = c;
+    } else {
+      out[used++] = '%';
+      out[used++] = hex[c >> 4];
+      out[used++] = hex[c & 15];
+    }
+  }
+  out[used] = '\0';
+}
+
+static bool fetch_stats(unsigned* requests, unsigned* hits, unsigned* coalesced, unsigned* upstream) {
+  char response[RESPONSE_MAX];
+  if (http_get("/stats", response, sizeof(response)) <= 0 || !http_ok(response)) {
+    return false;
+  }
+  const char* body = strstr(response, "\r\n\r\n");
+  return body && sscanf(body, " requests %u hits %u coalesced %u upstream %u",
+                        requests, hits, coalesced, upstream) == 4;
+}
+
+//------WATCHES------
+
+static void record_latency(WorkerStats* stats, double seconds) {
+  if (stats->count == stats->capacity) {
+    stats->capacity = stats->capacity ? stats->capacity * 2 : 1024;
+    stats->latencies_us = realloc(stats->latencies_us, stats->capacity * sizeof(uint32_t));
+  }
+  stats->latencies_us[stats->count++] = (uint32_t) (seconds * 1e6);
+}
+
+// What the phone does for one poll: the cell cache, then the proxy.
+static void phone_poll(Watch* watch, time_t sim_time, WorkerStats* stats) {
+  long row = (long) floor(watch->latitude / GRID_DEGREES);
+  long column = (long) floor(watch->longitude / GRID_DEGREES);
+  if (watch->cached_at && row == watch->cached_row && column == watch->cached_column &&
+      sim_time - watch->cached_at < PHONE_CACHE_SECONDS) {
+    stats->phone_hits++;
+    return;
+  }
+  char token[256], path[512], response[RESPONSE_MAX];
+  uri_encode(s_run.token, token, sizeof(token));
+  snprintf(path, sizeof(path), "/forecast?lat=%.4f&lon=%.4f&token=%s",
+           (row + 0.5) * GRID_DEGREES, (column + 0.5) * GRID_DEGREES, token);
+
+  double started = monotonic_now();
+  int length = http_get(path, response, sizeof(response));
+  record_latency(stats, monotonic_now() - started);
+  pthread_mutex_lock(&s_lock);
+  s_per_minute[(sim_time - s_run.sim_start) / 60]++;
+  pthread_mutex_unlock(&s_lock);
+  if (length <= 0 || !http_ok(response)) {
+    stats->errors++;
+    return;
+  }
+  const char* body = strstr(response, "\r\n\r\n");
+  stats->bytes += body ? length - (body + 4 - response) : 0;
+  watch->cached_row = row;
+  watch->cached_column = column;
+  watch->cached_at = sim_time;
+}
+
+static void* worker(void* data) {
+  WorkerStats* stats = data;
+  pthread_mutex_lock(&s_lock);
+  while (s_heap_size > 0) {
+    Watch* watch = &s_watches[s_heap[0]];
+    time_t due = watch->next_poll;
+    if (due >= s_run.sim_end) {
+      break;
+    }
+    double real_due = real_time_of(due);
+    double now = real_now();
+    if (now < real_due) {
+      struct timespec until = { (time_t) real_due, (long) ((real_due - (time_t) real_due) * 1e9) };
+      pthread_cond_timedwait(&s_pushed, &s_lock, &until);
+      continue;
+    }
+    if (now - real_due > stats->worst_lag) {
+      stats->worst_lag = now - real_due;
+    }
+    heap_pop();
+    pthread_mutex_unlock(&s_lock);
+
+    phone_poll(watch, due, stats);
+
+    pthread_mutex_lock(&s_lock);
+    watch->next_poll = next_poll_after(watch, due);
+    heap_push(watch - s_watches);
+    pthread_cond_signal(&s_pushed);
+  }
+  // Wake the others so they notice the run is over.
+  pthread_cond_broadcast(&s_pushed);
+  pthread_mutex_unlock(&s_lock);
+  return NULL;
+}
+
+static void place_watches(int count, double spread) {
+  for (int i = 0; i < count; i++) {
+    const City* city = &s_cities[rand() % CITY_COUNT];
+    Watch* watch = &s_watches[i];
+    *watch = (Watch) {
+      .latitude = city->latitude + spread * (2.0 * rand() / RAND_MAX - 1.0),
+      .longitude = city->longitude + spread * (2.0 * rand() / RAND_MAX - 1.0),
+      .utc_offset_minutes = city->utc_offset_minutes,
+      .lag_seconds = rand() % (PHONE_LAG_MAX_SECONDS + 1),
+    };
+    watch->next_poll = next_poll_after(watch, s_run.sim_start - 1);
+    heap_push(i);
+  }
+}
+
+//------REPORT------
+
+static int compare_u32(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+  return (x > y) - (x < y);
+}
+
+static double percentile_ms(const uint32_t* sorted, size_t count, double p) {
+  if (count == 0) {
+    return 0;
+  }
+  size_t rank = (size_t) ceil(p * count);
+  return sorted[rank ? rank - 1 : 0] / 1000.0;
+}
+
+static void usage(const char* name) {
+  fprintf(stderr,
+          "usage: %s [-n watches] [-t threads] [-m simulated minutes] [-x speedup]\n"
+          "          [-c cadence minutes] [-r spread degrees] [-k token] [-s seed] [host] [port]\n",
+          name);
+}
+
+int main(int argc, char** argv) {
+  int watch_count = 2000, thread_count = 512, minutes = 60;
+  double spread = 0.25;
+  unsigned seed = 1;
+  s_run.cadence_minutes = 10;
+  s_run.speedup = 60;
+  s_run.token = "";
+  int option;
+  while ((option = getopt(argc, argv, "n:t:m:x:c:r:k:s:")) != -1) {
+    switch (option) {
+      case 'n': watch_count = atoi(optarg); break;
+      case 't': thread_count = atoi(optarg); break;
+      case 'm': minutes = atoi(optarg); break;
+      case 'x': s_run.speedup = atof(optarg); break;
+      case 'c': s_run.cadence_minutes = atoi(optarg); break;
+      case 'r': spread = atof(optarg); break;
+      case 'k': s_run.token = optarg; break;
+      case 's': seed = (unsigned) atoi(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  s_run.host = optind < argc ? argv[optind] : "127.0.0.1";
+  s_run.port = optind + 1 < argc ? atoi(argv[optind + 1]) : 8080;
+  if (watch_count < 1 || thread_count < 1 || minutes < 1 || s_run.speedup <= 0 || s_run.cadence_minutes < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  unsigned requests0, hits0, coalesced0, upstream0;
+  if (!fetch_stats(&requests0, &hits0, &coalesced0, &upstream0)) {
+    fprintf(stderr, "no proxy answering /stats on %s:%d\n", s_run.host, s_run.port);
+    return 1;
+  }
+
+  // Start on a whole hour, so the first polls line up the way they would.
+  s_run.real_start = real_now() + 1;
+  s_run.sim_start = (time_t) s_run.real_start / 3600 * 3600;
+  s_run.sim_end = s_run.sim_start + minutes * 60;
+  s_watches = calloc(watch_count, sizeof(Watch));
+  s_heap = calloc(watch_count, sizeof(int));
+  s_per_minute = calloc(minutes, sizeof(unsigned));
+  WorkerStats* stats = calloc(thread_count, sizeof(WorkerStats));
+  pthread_t* threads = calloc(thread_count, sizeof(pthread_t));
+  if (!s_watches || !s_heap || !s_per_minute || !stats || !threads) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  srand(seed);
+  place_watches(watch_count, spread);
+
+  for (int i = 0; i < thread_count; i++) {
+    pthread_create(&threads[i], NULL, worker, &stats[i]);
+  }
+  for (int i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  double elapsed = real_now() - s_run.real_start;
+
+  WorkerStats total = { 0 };
+  for (int i = 0; i < thread_count; i++) {
+    total.count += stats[i].count;
+  }
+  total.latencies_us = malloc((total.count + 1) * sizeof(uint32_t));
+  for (int i = 0; i < thread_count; i++) {
+    memcpy(total.latencies_us + total.capacity, stats[i].latencies_us, stats[i].count * sizeof(uint32_t));
+    total.capacity += stats[i].count;
+    total.errors += stats[i].errors;
+    total.phone_hits += stats[i].phone_hits;
+    total.bytes += stats[i].bytes;
+    total.worst_lag = fmax(total.worst_lag, stats[i].worst_lag);
+    free(stats[i].latencies_us);
+  }
+  qsort(total.latencies_us, total.count, sizeof(uint32_t), compare_u32);
+  unsigned peak = 0;
+  for (int i = 0; i < minutes; i++) {
+    peak = s_per_minute[i] > peak ? s_per_minute[i] : peak;
+  }
+  size_t served = total.count - total.errors;
+
+  printf("%d watches, %d simulated minutes in %.1f s, polling every %d minutes\n",
+         watch_count, minutes, elapsed, s_run.cadence_minutes);
+  printf(" - Polls: %zu, %u answered from the phone's cache\n", total.count + total.phone_hits, total.phone_hits);
+  printf(" - Requests: %zu, %u failed, %.0f bytes average payload\n",
+         total.count, total.errors, served ? (double) total.bytes / served : 0.0);
+  printf(" - Request rate: %.2f/s average, %.2f/s in the busiest minute, in fleet time\n",
+         total.count / (minutes * 60.0), peak / 60.0);
+  printf(" - Latency: p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+         percentile_ms(total.latencies_us, total.count, 0.50),
+         percentile_ms(total.latencies_us, total.count, 0.99),
+         percentile_ms(total.latencies_us, total.count, 1.0));
+  printf(" - Worst scheduling lag: %.0f ms%s\n", total.worst_lag * 1000,
+         total.worst_lag * s_run.speedup > 60 ? " (behind by over a simulated minute; add threads)" : "");
+
+  unsigned requests1, hits1, coalesced1, upstream1;
+  if (fetch_stats(&requests1, &hits1, &coalesced1, &upstream1)) {
+    unsigned requests = requests1 - requests0, hits = hits1 - hits0, coalesced = coalesced1 - coalesced0;
+    printf(" - Proxy: %u upstream fetches, cache hit ratio %.1f%% (%.1f%% coalesced onto a fetch)\n",
+           upstream1 - upstream0, requests ? 100.0 * (hits + coalesced) / requests : 0.0,
+           requests ? 100.0 * coalesced / requests : 0.0);
+  }
+
+  free(total.latencies_us);
+  free(stats);
+  free(threads);
+  free(s_per_minute);
+  free(s_heap);
+  free(s_watches);
+  return total.errors ? 2 : 0;
+}
@@ -0,0 +1,160 @@
+// A caching proxy in front of the forecast API, so a team of watches shares
+// one upstream request per tile rather than every phone making its own.
+//
+//   TIDEY_API_KEY=<forecast.io key> TIDEY_PROXY_TOKEN=<token> ./tidey_proxy 8080
+//
+// Then set PROXY_URL in src/js/pebble-js-app.js and put the token in place of
+// the API key in src/secret.h. Upstream requests go through curl(1) so
+// HTTPS works without linking a TLS library.
+//
+// Environment:
+//   TIDEY_API_KEY      forecast.io key (required)
+//   TIDEY_PROXY_TOKEN  token clients must send (optional, but do set it)
+//   TIDEY_UPSTREAM     base URL, default https://api.forecast.io/forecast
+//   TIDEY_TTL          seconds to cache a tile, default 900
+//   TIDEY_PRECISION    geohash characters per tile, default 5
+//
+// To stand in for the real thing under loadgen, serve a fixture instead:
+//   TIDEY_FIXTURE      forecast JSON to answer every fetch with
+//   TIDEY_FIXTURE_DELAY_MS  how long each fake fetch takes, default 300
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "proxy.h"
+
+#define DEFAULT_PORT 8080
+#define DEFAULT_UPSTREAM "https://api.forecast.io/forecast"
+#define DEFAULT_TTL 900
+#define BODY_MAX (1024 * 1024)
+#define DEFAULT_FIXTURE_DELAY_MS 300
+
+typedef struct {
+  const char* key;
+  const char* upstream;
+} Upstream;
+
+// Only ever passed through the shell inside single quotes.
+static bool shell_safe(const char* text) {
+  return strchr(text, '\'') == NULL;
+}
+
+static bool fetch_with_curl(double latitude, double longitude, char** body, size_t* length, void* context) {
+  const Upstream* upstream = context;
+  char command[512];
+  int written = snprintf(command, sizeof(command),
+                         "curl -sf --max-time 15 '%s/%s/%.4f,%.4f?units=uk&exclude=daily,alerts,flags'",
+                         upstream->upstream, upstream->key, latitude, longitude);
+  if (written < 0 || written >= (int) sizeof(command)) {
+    return false;
+  }
+  FILE* pipe = popen(command, "r");
+  if (!pipe) {
+    return false;
+  }
+  *body = malloc(BODY_MAX);
+  *length = *body ? fread(*body, 1, BODY_MAX, pipe) : 0;
+  int status = pclose(pipe);
+  if (status != 0 || *length == 0) {
+    fprintf(stderr, "upstream fetch for %.4f,%.4f failed (%d)\n", latitude, longitude, status);
+    return false;
+  }
+  return true;
+}
+
+typedef struct {
+  char* body;
+  size_t length;
+  long delay_ms;
+} Fixture;
+
+static bool fetch_fixture(double latitude, double longitude, char** body, size_t* length, void* context) {
+  const Fixture* fixture = context;
+  struct timespec delay = { fixture->delay_ms / 1000, fixture->delay_ms % 1000 * 1000000 };
+  nanosleep(&delay, NULL);
+  *body = malloc(fixture->length);
+  if (!*body) {
+    return false;
+  }
+  memcpy(*body, fixture->body, fixture->length);
+  *length = fixture->length;
+  return true;
+}
+
+static bool load_fixture(const char* path, Fixture* fixture) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  fixture->body = malloc(BODY_MAX);
+  fixture->length = fixture->body ? fread(fixture->body, 1, BODY_MAX, file) : 0;
+  fclose(file);
+  const char* delay = getenv("TIDEY_FIXTURE_DELAY_MS");
+  fixture->delay_ms = delay ? atol(delay) : DEFAULT_FIXTURE_DELAY_MS;
+  return fixture->length > 0;
+}
+
+static void* serve(void* data) {
+  proxy_handle_connection((int) (intptr_t) data);
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  Upstream upstream = { getenv("TIDEY_API_KEY"), getenv("TIDEY_UPSTREAM") };
+  Fixture fixture;
+  const char* fixture_path = getenv("TIDEY_FIXTURE");
+  if (!upstream.upstream) {
+    upstream.upstream = DEFAULT_UPSTREAM;
+  }
+  if (fixture_path) {
+    if (!load_fixture(fixture_path, &fixture)) {
+      fprintf(stderr, "can't read %s\n", fixture_path);
+      return 1;
+    }
+  } else if (!upstream.key || !shell_safe(upstream.key) || !shell_safe(upstream.upstream)) {
+    fprintf(stderr, "set TIDEY_API_KEY (and TIDEY_UPSTREAM, if used) without quotes\n");
+    return 1;
+  }
+  ProxyConfig config = {
+    .fetch = fixture_path ? fetch_fixture : fetch_with_curl,
+    .context = fixture_path ? (void*) &fixture : (void*) &upstream,
+    .ttl = getenv("TIDEY_TTL") ? atoi(getenv("TIDEY_TTL")) : DEFAULT_TTL,
+    .precision = getenv("TIDEY_PRECISION") ? atoi(getenv("TIDEY_PRECISION")) : 5,
+    .token = getenv("TIDEY_PROXY_TOKEN"),
+  };
+  if (!config.token) {
+    fprintf(stderr, "warning: TIDEY_PROXY_TOKEN not set, anyone can use this proxy\n");
+  }
+  proxy_init(&config);
+
+  int port = argc > 1 ? atoi(argv[1]) : DEFAULT_PORT;
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+  if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+    perror("listen");
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  fprintf(stderr, "listening on port %d\n", port);
+
+  for (;;) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, serve, (void*) (intptr_t) fd) == 0) {
+      pthread_detach(thread);
+    } else {
+      close(fd);
+    }
+  }
+}
@@ -0,0 +1,250 @@
+#include "payload.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+
+#include "json_scan.h"
+#include "forecast.h"
+#include "precipitation.h"
+#include "summary_words.h"
+
+static const char* const WORDS[] = { SUMMARY_WORDS };
+#define WORD_COUNT (sizeof(WORDS) / sizeof(WORDS[0]))
+
+// Summaries rarely need more than this.
+#define SUMMARY_TEXT_SIZE 256
+#define SUMMARY_TOKENS_MAX 255
+// Minutes less likely than this to see rain are sent as dry, as in the JS.
+#define PRECIPITATION_MIN_PROBABILITY 0.5
+
+typedef struct {
+  Payload* payload;
+  bool overflow;
+} Writer;
+
+static void put(Writer* writer, const void* data, size_t length) {
+  if (writer->payload->length + length > PAYLOAD_MAX) {
+    writer->overflow = true;
+    return;
+  }
+  memcpy(&writer->payload->bytes[writer->payload->length], data, length);
+  writer->payload->length += length;
+}
+
+static void put_u8(Writer* writer, uint8_t value) {
+  put(writer, &value, 1);
+}
+
+static void put_u16(Writer* writer, uint16_t value) {
+  uint8_t bytes[] = { value, value >> 8 };
+  put(writer, bytes, sizeof(bytes));
+}
+
+static void put_u32(Writer* writer, uint32_t value) {
+  uint8_t bytes[] = { value, value >> 8, value >> 16, value >> 24 };
+  put(writer, bytes, sizeof(bytes));
+}
+
+// Round half to even, like evenRound() in the JS.
+static long even_round(double value) {
+  return lrint(value);
+}
+
+static int clamp(long value, int low, int high) {
+  return value < low ? low : value > high ? high : (int) value;
+}
+
+static size_t put_literal(uint8_t* tokens, size_t used, size_t size, const char* text, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    uint8_t b = text[i];
+    bool clashes = b >= SUMMARY_TOKEN_WORD || b == SUMMARY_TOKEN_CAPITAL || b == SUMMARY_TOKEN_ESCAPE;
+    if (used + (clashes ? 2 : 1) > size) {
+      break;
+    }
+    if (clashes) {
+      tokens[used++] = SUMMARY_TOKEN_ESCAPE;
+    }
+    tokens[used++] = b;
+  }
+  return used;
+}
+
+static int find_word(const char* word, size_t length) {
+  for (size_t i = 0; i < WORD_COUNT; i++) {
+    if (strlen(WORDS[i]) == length && strncmp(WORDS[i], word, length) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Same rules as encodeSummary() in the JS: each space-separated piece that
+// starts with a known word, lower case or capitalised, becomes a token.
+size_t payload_encode_summary(const char* text, uint8_t* tokens, size_t size) {
+  size_t used = 0;
+  while (*text == ' ') {
+    text++;
+  }
+  size_t text_length = strlen(text);
+  while (text_length > 0 && text[text_length - 1] == ' ') {
+    text_length--;
+  }
+
+  const char* piece = text;
+  const char* end = text + text_length;
+  bool first = true;
+  while (piece <= end && used < size) {
+    const char* piece_end = memchr(piece, ' ', end - piece);
+    if (!piece_end) {
+      piece_end = end;
+    }
+    size_t word_length = 0;
+    while (piece + word_length < piece_end && isalpha((unsigned char) piece[word_length])) {
+      word_length++;
+    }
+
+    char lower[32];
+    int index = -1;
+    bool capital = false;
+    if (word_length > 0 && word_length < sizeof(lower)) {
+      bool rest_lower = true;
+      for (size_t i = 0; i < word_length; i++) {
+        lower[i] = tolower((unsigned char) piece[i]);
+        rest_lower &= i == 0 || piece[i] == lower[i];
+      }
+      capital = piece[0] != lower[0];
+      if (rest_lower) {
+        index = find_word(lower, word_length);
+      }
+    }
+
+    if (index < 0) {
+      if (!first) {
+        used = put_literal(tokens, used, size, " ", 1);
+      }
+      used = put_literal(tokens, used, size, piece, piece_end - piece);
+    } else {
+      if (capital && used < size) {
+        tokens[used++] = SUMMARY_TOKEN_CAPITAL;
+      }
+      if (used < size) {
+        tokens[used++] = SUMMARY_TOKEN_WORD + index;
+      }
+      used = put_literal(tokens, used, size, piece + word_length, piece_end - piece - word_length);
+    }
+    first = false;
+    piece = piece_end + 1;
+  }
+  return used;
+}
+
+static void put_precipitation(Writer* writer, JsonSpan minutes) {
+  uint8_t bytes[PRECIPITATION_HEADER_SIZE + PRECIPITATION_MAX_MINUTES];
+  size_t length = PRECIPITATION_HEADER_SIZE;
+  const char* cursor = NULL;
+  JsonSpan minute;
+  double start = 0;
+  while (length < sizeof(bytes) && json_next_object(minutes, &cursor, &minute)) {
+    if (length == PRECIPITATION_HEADER_SIZE) {
+      json_number(minute, "time", &start);
+    }
+    double probability = 0;
+    double intensity = 0;
+    json_number(minute, "precipProbability", &probability);
+    json_number(minute, "precipIntensity", &intensity);
+    bytes[length++] = probability >= PRECIPITATION_MIN_PROBABILITY ? clamp(even_round(intensity * 20), 0, 255) : 0;
+  }
+  uint32_t start_time = (uint32_t) start;
+  for (int i = 0; i < 4; i++) {
+    bytes[i] = start_time >> (8 * i);
+  }
+  put_u8(writer, length);
+  put(writer, bytes, length);
+}
+
+// The same layout encodeHourly() builds in the JS.
+static void put_hourly(Writer* writer, JsonSpan hours) {
+  uint8_t bytes[6 + FORECAST_HOURS * (4 + FORECAST_SUMMARY_SIZE - 1)];
+  size_t length = 6;
+  uint8_t count = 0;
+  double start = 0;
+  const char* cursor = NULL;
+  JsonSpan hour;
+  while (count < FORECAST_HOURS && json_next_object(hours, &cursor, &hour)) {
+    if (count == 0) {
+      json_number(hour, "time", &start);
+    }
+    double temperature = 0;
+    double wind_speed = 0;
+    double wind_bearing = 0;
+    char summary[SUMMARY_TEXT_SIZE] = "";
+    json_number(hour, "apparentTemperature", &temperature);
+    json_number(hour, "windSpeed", &wind_speed);
+    json_number(hour, "windBearing", &wind_bearing);
+    json_string(hour, "summary", summary, sizeof(summary));
+
+    bytes[length++] = (uint8_t) clamp(even_round(temperature), -128, 127);
+    bytes[length++] = clamp(even_round(wind_speed), 0, 255);
+    bytes[length++] = ((int) wind_bearing / 2) & 0xff;
+    uint8_t* summary_length = &bytes[length++];
+    *summary_length = 0;
+    for (const char* c = summary; *c && *summary_length < FORECAST_SUMMARY_SIZE - 1; c++) {
+      if (*c >= 0x20 && *c <= 0x7e) {
+        bytes[length++] = *c;
+        (*summary_length)++;
+      }
+    }
+    count++;
+  }
+  uint32_t start_time = (uint32_t) start;
+  bytes[0] = TRANSFER_KIND_HOURLY;
+  for (int i = 0; i < 4; i++) {
+    bytes[1 + i] = start_time >> (8 * i);
+  }
+  bytes[5] = count;
+  put_u16(writer, length);
+  put(writer, bytes, length);
+}
+
+// Returns 0, or -1 if a field the watch needs is missing.
+int payload_from_forecast(const char* json, size_t length, Payload* payload) {
+  JsonSpan root = { json, json + length };
+  JsonSpan currently, minutely, minutes, hourly, hours;
+  if (!json_find(root, "currently", &currently) || !json_find(root, "minutely", &minutely) ||
+      !json_find(minutely, "data", &minutes) || !json_find(root, "hourly", &hourly) ||
+      !json_find(hourly, "data", &hours)) {
+    return -1;
+  }
+  double temperature, wind_speed, hour_from;
+  double wind_bearing = 0;  // left out when it's calm
+  JsonSpan first_minute;
+  const char* cursor = NULL;
+  char summary[SUMMARY_TEXT_SIZE];
+  if (!json_number(currently, "apparentTemperature", &temperature) ||
+      !json_number(currently, "windSpeed", &wind_speed) ||
+      !json_next_object(minutes, &cursor, &first_minute) ||
+      !json_number(first_minute, "time", &hour_from) ||
+      !json_string(minutely, "summary", summary, sizeof(summary))) {
+    return -1;
+  }
+  json_number(currently, "windBearing", &wind_bearing);
+
+  payload->length = 0;
+  Writer writer = { payload, false };
+  put(&writer, "TW", 2);
+  put_u8(&writer, PAYLOAD_VERSION);
+  put_u16(&writer, (uint16_t) (int16_t) even_round(temperature));
+  put_u32(&writer, (uint32_t) hour_from);
+  put_u8(&writer, clamp(even_round(wind_speed), 0, 255));
+  put_u16(&writer, clamp(even_round(wind_bearing), 0, 359));
+
+  uint8_t tokens[SUMMARY_TOKENS_MAX];
+  size_t token_count = payload_encode_summary(summary, tokens, sizeof(tokens));
+  put_u8(&writer, token_count);
+  put(&writer, tokens, token_count);
+
+  put_precipitation(&writer, minutes);
+  put_hourly(&writer, hours);
+  return writer.overflow ? -1 : 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What the proxy returns: everything the phone would otherwise pull out of
+// the forecast itself, already in the watch's encodings. Little-endian:
+//   "TW", version (1)
+//   temperature (2, signed), hour from (4), wind speed (1), wind bearing (2)
+//   summary token count (1), summary tokens     see src/summary_words.h
+//   precipitation length (1), precipitation    see src/precipitation.h
+//   hourly length (2), hourly transfer          see src/forecast.c
+// Must match decodeProxyPayload() in src/js/pebble-js-app.js.
+#define PAYLOAD_VERSION 1
+#define PAYLOAD_MAX 1024
+
+typedef struct {
+  uint8_t bytes[PAYLOAD_MAX];
+  size_t length;
+} Payload;
+
+size_t payload_encode_summary(const char* text, uint8_t* tokens, size_t size);
+int payload_from_forecast(const char* json, size_t length, Payload* payload);
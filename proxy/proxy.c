@@ -0,0 +1,281 @@
+#include "proxy.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "geohash.h"
+
+#define CACHE_SLOTS 256
+#define REQUEST_MAX 2048
+
+typedef enum {
+  SlotEmpty = 0,
+  SlotFetching,
+  SlotReady
+} SlotState;
+
+typedef struct {
+  SlotState state;
+  char tile[GEOHASH_MAX_PRECISION + 1];
+  time_t fetched_at;
+  Payload payload;
+} Slot;
+
+static ProxyConfig s_config;
+static Slot* s_slots = NULL;
+static ProxyStats s_stats;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+// Signalled whenever a fetch finishes, for requests waiting on it.
+static pthread_cond_t s_fetched = PTHREAD_COND_INITIALIZER;
+
+static time_t now(void) {
+  return s_config.now ? s_config.now() : time(NULL);
+}
+
+void proxy_init(const ProxyConfig* config) {
+  s_config = *config;
+  if (s_config.precision < 1 || s_config.precision > GEOHASH_MAX_PRECISION) {
+    s_config.precision = 5;
+  }
+  s_slots = calloc(CACHE_SLOTS, sizeof(Slot));
+  memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void proxy_deinit(void) {
+  free(s_slots);
+  s_slots = NULL;
+}
+
+ProxyStats proxy_stats(void) {
+  pthread_mutex_lock(&s_lock);
+  ProxyStats stats = s_stats;
+  pthread_mutex_unlock(&s_lock);
+  return stats;
+}
+
+static Slot* find_slot(const char* tile) {
+  for (int i = 0; i < CACHE_SLOTS; i++) {
+    if (s_slots[i].state != SlotEmpty && strcmp(s_slots[i].tile, tile) == 0) {
+      return &s_slots[i];
+    }
+  }
+  return NULL;
+}
+
+// An empty slot, or else the oldest one not being fetched into.
+static Slot* claim_slot(void) {
+  Slot* oldest = NULL;
+  for (int i = 0; i < CACHE_SLOTS; i++) {
+    Slot* slot = &s_slots[i];
+    if (slot->state == SlotEmpty) {
+      return slot;
+    }
+    if (slot->state == SlotReady && (!oldest || slot->fetched_at < oldest->fetched_at)) {
+      oldest = slot;
+    }
+  }
+  return oldest;
+}
+
+static bool fetch_tile(const char* tile, Payload* payload) {
+  double latitude, longitude;
+  geohash_centre(tile, &latitude, &longitude);
+  char* body = NULL;
+  size_t length = 0;
+  bool ok = s_config.fetch(latitude, longitude, &body, &length, s_config.context) &&
+            payload_from_forecast(body, length, payload) == 0;
+  free(body);
+  return ok;
+}
+
+// Serves a tile from cache while it's fresh. Otherwise the first request
+// fetches it and any others for the same tile wait for that one.
+int proxy_get(double latitude, double longitude, Payload* payload) {
+  char tile[GEOHASH_MAX_PRECISION + 1];
+  geohash_encode(latitude, longitude, s_config.precision, tile);
+
+  pthread_mutex_lock(&s_lock);
+  s_stats.requests++;
+  bool waited = false;
+  Slot* slot;
+  for (;;) {
+    slot = find_slot(tile);
+    if (slot && slot->state == SlotReady && now() - slot->fetched_at < s_config.ttl) {
+      *payload = slot->payload;
+      if (waited) {
+        // Only once the fetch it waited on has actually served it.
+        s_stats.coalesced++;
+      } else {
+        s_stats.hits++;
+      }
+      pthread_mutex_unlock(&s_lock);
+      return 0;
+    }
+    if (slot && slot->state == SlotFetching) {
+      waited = true;
+      pthread_cond_wait(&s_fetched, &s_lock);
+      continue;
+    }
+    if (!slot) {
+      slot = claim_slot();
+      if (!slot) {
+        // Every slot is mid-fetch; wait for one to come free.
+        pthread_cond_wait(&s_fetched, &s_lock);
+        continue;
+      }
+    }
+    break;
+  }
+  // If we waited, the fetch we waited on failed; this one is ours, not coalesced.
+  slot->state = SlotFetching;
+  strcpy(slot->tile, tile);
+  s_stats.upstream++;
+  pthread_mutex_unlock(&s_lock);
+
+  bool ok = fetch_tile(tile, payload);
+
+  pthread_mutex_lock(&s_lock);
+  if (ok) {
+    slot->state = SlotReady;
+    slot->fetched_at = now();
+    slot->payload = *payload;
+  } else {
+    slot->state = SlotEmpty;
+    s_stats.failures++;
+  }
+  pthread_cond_broadcast(&s_fetched);
+  pthread_mutex_unlock(&s_lock);
+  return ok ? 0 : -1;
+}
+
+static void respond(int fd, int status, const char* reason, const void* body, size_t length) {
+  char header[256];
+  int header_length = snprintf(header, sizeof(header),
+                               "HTTP/1.0 %d %s\r\n"
+                               "Content-Type: application/octet-stream\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Connection: close\r\n\r\n",
+                               status, reason, length);
+  if (write(fd, header, header_length) == header_length && length > 0) {
+    ssize_t written = write(fd, body, length);
+    (void) written;
+  }
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Copies the URL-decoded value of "name" from a query string, returning
+// false if absent, badly encoded or too long.
+static bool query_value(const char* query, const char* name, char* out, size_t size) {
+  size_t name_length = strlen(name);
+  for (const char* at = query; at && *at; at = strchr(at, '&'), at = at ? at + 1 : NULL) {
+    if (strncmp(at, name, name_length) == 0 && at[name_length] == '=') {
+      const char* value = at + name_length + 1;
+      const char* end = value + strcspn(value, "& ");
+      size_t length = 0;
+      for (const char* c = value; c < end; c++) {
+        char decoded = *c == '+' ? ' ' : *c;
+        if (*c == '%') {
+          int high = c + 2 < end ? hex_digit(c[1]) : -1;
+          int low = high >= 0 ? hex_digit(c[2]) : -1;
+          if (low < 0 || (high == 0 && low == 0)) {
+            return false;
+          }
+          decoded = (char) (high << 4 | low);
+          c += 2;
+        }
+        if (length + 1 >= size) {
+          return false;
+        }
+        out[length++] = decoded;
+      }
+      out[length] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+// Takes as long whatever the guess, so the token can't be found a byte at a time.
+static bool token_matches(const char* guess, const char* token) {
+  size_t guess_length = strlen(guess);
+  size_t token_length = strlen(token);
+  unsigned char difference = guess_length != token_length;
+  for (size_t i = 0; i < token_length; i++) {
+    difference |= (unsigned char) token[i] ^ (unsigned char) (i < guess_length ? guess[i] : 0);
+  }
+  return difference == 0;
+}
+
+static bool parse_coordinate(const char* text, double limit, double* value) {
+  char* end;
+  *value = strtod(text, &end);
+  return end != text && *end == '\0' && *value >= -limit && *value <= limit;
+}
+
+static void respond_stats(int fd) {
+  ProxyStats stats = proxy_stats();
+  char body[256];
+  int length = snprintf(body, sizeof(body),
+                        "requests %u\nhits %u\ncoalesced %u\nupstream %u\nfailures %u\n",
+                        stats.requests, stats.hits, stats.coalesced, stats.upstream, stats.failures);
+  respond(fd, 200, "OK", body, length);
+}
+
+// Handles one "GET /forecast?lat=..&lon=..&token=.." or "GET /stats" and
+// closes the socket.
+void proxy_handle_connection(int fd) {
+  char request[REQUEST_MAX];
+  size_t used = 0;
+  while (used < sizeof(request) - 1) {
+    ssize_t got = read(fd, &request[used], sizeof(request) - 1 - used);
+    if (got <= 0) {
+      break;
+    }
+    used += got;
+    request[used] = '\0';
+    if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+      break;
+    }
+  }
+  request[used] = '\0';
+
+  char lat_text[32], lon_text[32], token[128];
+  double latitude, longitude;
+  const char* query = strncmp(request, "GET /forecast?", 14) == 0 ? request + 14 : NULL;
+  if (!query && strncmp(request, "GET /stats ", 11) == 0) {
+    respond_stats(fd);
+  } else if (!query) {
+    respond(fd, 404, "Not Found", NULL, 0);
+  } else if (!query_value(query, "lat", lat_text, sizeof(lat_text)) ||
+             !query_value(query, "lon", lon_text, sizeof(lon_text)) ||
+             !parse_coordinate(lat_text, 90, &latitude) ||
+             !parse_coordinate(lon_text, 180, &longitude)) {
+    respond(fd, 400, "Bad Request", NULL, 0);
+  } else if (s_config.token && (!query_value(query, "token", token, sizeof(token)) ||
+                                !token_matches(token, s_config.token))) {
+    respond(fd, 403, "Forbidden", NULL, 0);
+  } else {
+    Payload payload;
+    if (proxy_get(latitude, longitude, &payload) == 0) {
+      respond(fd, 200, "OK", payload.bytes, payload.length);
+    } else {
+      respond(fd, 502, "Bad Gateway", NULL, 0);
+    }
+  }
+  close(fd);
+}
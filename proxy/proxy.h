@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "payload.h"
+
+// Fetches the forecast for a point, handing back a malloc()ed body.
+typedef bool (*ProxyFetcher)(double latitude, double longitude, char** body, size_t* length, void* context);
+
+typedef struct {
+  ProxyFetcher fetch;
+  void* context;
+  int ttl;               // seconds a tile's forecast is served from cache
+  int precision;         // geohash characters per tile
+  const char* token;     // clients must send this, unless NULL
+  time_t (*now)(void);   // for tests; time() if NULL
+} ProxyConfig;
+
+typedef struct {
+  unsigned requests;
+  unsigned hits;
+  unsigned coalesced;    // waited for a fetch another request started
+  unsigned upstream;
+  unsigned failures;
+} ProxyStats;
+
+void proxy_init(const ProxyConfig* config);
+void proxy_deinit(void);
+int proxy_get(double latitude, double longitude, Payload* payload);
+void proxy_handle_connection(int fd);
+ProxyStats proxy_stats(void);
@@ -0,0 +1,302 @@
+// Proxy tests, run offline against a fake upstream serving
+// tests/fixtures/forecast.json.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "unit.h"
+#include "geohash.h"
+#include "json_scan.h"
+#include "payload.h"
+#include "proxy.h"
+#include "precipitation.h"
+#include "summary_words.h"
+
+#define FIXTURE "tests/fixtures/forecast.json"
+#define TOKEN "team-token"
+
+int tests_run = 0;
+int tests_passed = 0;
+
+// The fake upstream.
+static char* s_fixture = NULL;
+static size_t s_fixture_length = 0;
+static unsigned s_fetches = 0;
+static bool s_fail = false;
+static long s_delay_ms = 0;
+static time_t s_now = 1792314000;
+
+static bool fake_fetch(double latitude, double longitude, char** body, size_t* length, void* context) {
+  if (s_delay_ms) {
+    struct timespec delay = { 0, s_delay_ms * 1000000 };
+    nanosleep(&delay, NULL);
+  }
+  __sync_fetch_and_add(&s_fetches, 1);
+  if (s_fail) {
+    return false;
+  }
+  *body = malloc(s_fixture_length);
+  memcpy(*body, s_fixture, s_fixture_length);
+  *length = s_fixture_length;
+  return true;
+}
+
+static time_t fake_now(void) {
+  return s_now;
+}
+
+static void before_each(void) {
+  s_fetches = 0;
+  s_fail = false;
+  s_delay_ms = 0;
+  ProxyConfig config = { .fetch = fake_fetch, .ttl = 900, .precision = 5, .token = TOKEN, .now = fake_now };
+  proxy_init(&config);
+}
+
+static void after_each(void) {
+  proxy_deinit();
+}
+
+static bool load_fixture(void) {
+  FILE* file = fopen(FIXTURE, "rb");
+  if (!file) {
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  s_fixture_length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  s_fixture = malloc(s_fixture_length);
+  bool ok = fread(s_fixture, 1, s_fixture_length, file) == s_fixture_length;
+  fclose(file);
+  return ok;
+}
+
+static uint32_t read_u32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static char* test_geohash(void) {
+  char hash[GEOHASH_MAX_PRECISION + 1];
+  geohash_encode(57.64911, 10.40744, 11, hash);
+  mu_assert(strcmp(hash, "u4pruydqqvj") == 0, "geohash should match the reference value");
+  double latitude, longitude;
+  geohash_encode(51.1279, 1.3134, 5, hash);
+  geohash_centre(hash, &latitude, &longitude);
+  mu_assert(latitude > 51.1 && latitude < 51.15 && longitude > 1.28 && longitude < 1.34,
+            "tile centre should be near the point");
+  return 0;
+}
+
+static char* test_json_scan(void) {
+  const char* text = "{\"a\": {\"n\": -1.5e1, \"s\": \"x\\\"y\\u00e9\"}, \"list\": [{\"n\": 1}, {\"n\": 2}]}";
+  JsonSpan root = { text, text + strlen(text) };
+  JsonSpan a, list, item;
+  double number;
+  char string[16];
+  mu_assert(json_find(root, "a", &a) && json_number(a, "n", &number) && number == -15, "number should parse");
+  mu_assert(json_string(a, "s", string, sizeof(string)) && strcmp(string, "x\"y\xc3\xa9") == 0,
+            "string should unescape");
+  mu_assert(json_find(root, "list", &list), "array should be found");
+  const char* cursor = NULL;
+  int count = 0;
+  while (json_next_object(list, &cursor, &item)) {
+    json_number(item, "n", &number);
+    count++;
+  }
+  mu_assert(count == 2 && number == 2, "array objects should be walked");
+  return 0;
+}
+
+static char* test_summary_tokens_round_trip(void) {
+  const char* summaries[] = { "Light rain starting in 12 min.", "Mostly Cloudy", "RAIN caf\xc3\xa9  x", "Drizzle" };
+  for (size_t i = 0; i < sizeof(summaries) / sizeof(summaries[0]); i++) {
+    uint8_t tokens[64];
+    char text[86];
+    size_t count = payload_encode_summary(summaries[i], tokens, sizeof(tokens));
+    summary_words_expand(tokens, count, text, sizeof(text));
+    mu_assert(strcmp(text, summaries[i]) == 0, "summary should survive tokens");
+  }
+  uint8_t tokens[64];
+  mu_assert(payload_encode_summary("Light rain starting in 12 min.", tokens, sizeof(tokens)) == 10,
+            "summary should shrink as it does in the JS");
+  return 0;
+}
+
+static char* test_payload_from_fixture(void) {
+  Payload payload;
+  mu_assert(payload_from_forecast(s_fixture, s_fixture_length, &payload) == 0, "fixture should encode");
+  const uint8_t* p = payload.bytes;
+  mu_assert(p[0] == 'T' && p[1] == 'W' && p[2] == PAYLOAD_VERSION, "payload should start with its header");
+  mu_assert((int16_t) (p[3] | (p[4] << 8)) == 12, "11.5 should round to even");
+  mu_assert(read_u32(&p[5]) == 1792314000, "hour from should be the first minute");
+  mu_assert(p[9] == 16 && (p[10] | (p[11] << 8)) == 214, "wind should match");
+
+  size_t at = 12;
+  char summary[86];
+  summary_words_expand(&p[at + 1], p[at], summary, sizeof(summary));
+  mu_assert(strcmp(summary, "Light rain starting in 12 min.") == 0, "summary should expand on the watch");
+  at += 1 + p[at];
+
+  uint8_t precipitation_length = p[at];
+  mu_assert(precipitation_length == PRECIPITATION_HEADER_SIZE + PRECIPITATION_MAX_MINUTES,
+            "a full hour of precipitation should be sent");
+  mu_assert(precipitation_next_onset(&p[at + 1], precipitation_length, 1792314000) == 1792314000 + 12 * 60,
+            "rain should start at minute 12");
+  at += 1 + precipitation_length;
+
+  uint16_t hourly_length = p[at] | (p[at + 1] << 8);
+  const uint8_t* hourly = &p[at + 2];
+  mu_assert(hourly[0] == 1 && read_u32(&hourly[1]) == 1792314000 && hourly[5] == 12,
+            "hourly transfer should hold twelve hours");
+  mu_assert(at + 2 + hourly_length == payload.length, "payload should end with the hourly transfer");
+  return 0;
+}
+
+static char* test_cache_serves_tile(void) {
+  Payload payload;
+  mu_assert(proxy_get(51.1279, 1.3134, &payload) == 0, "first request should succeed");
+  mu_assert(proxy_get(51.1279, 1.3134, &payload) == 0, "second request should succeed");
+  mu_assert(proxy_get(51.1290, 1.3140, &payload) == 0, "nearby request should succeed");
+  ProxyStats stats = proxy_stats();
+  mu_assert(s_fetches == 1 && stats.upstream == 1 && stats.hits == 2, "one tile should mean one fetch");
+  proxy_get(51.5074, -0.1278, &payload);
+  mu_assert(s_fetches == 2, "another tile should be fetched separately");
+
+  s_now += 901;
+  proxy_get(51.1279, 1.3134, &payload);
+  mu_assert(s_fetches == 3, "expired tile should be fetched again");
+  s_now -= 901;
+  return 0;
+}
+
+static char* test_failed_fetch_not_cached(void) {
+  Payload payload;
+  s_fail = true;
+  mu_assert(proxy_get(51.1279, 1.3134, &payload) == -1, "failed fetch should fail the request");
+  s_fail = false;
+  mu_assert(proxy_get(51.1279, 1.3134, &payload) == 0, "next request should try again");
+  mu_assert(s_fetches == 2 && proxy_stats().failures == 1, "failure should be counted, not cached");
+  return 0;
+}
+
+#define CONCURRENT 16
+
+static void* concurrent_get(void* data) {
+  Payload payload;
+  *(int*) data = proxy_get(51.1279, 1.3134, &payload);
+  return NULL;
+}
+
+static char* test_concurrent_requests_coalesce(void) {
+  s_delay_ms = 100;
+  pthread_t threads[CONCURRENT];
+  int results[CONCURRENT];
+  for (int i = 0; i < CONCURRENT; i++) {
+    pthread_create(&threads[i], NULL, concurrent_get, &results[i]);
+  }
+  for (int i = 0; i < CONCURRENT; i++) {
+    pthread_join(threads[i], NULL);
+    mu_assert(results[i] == 0, "every waiting request should be served");
+  }
+  ProxyStats stats = proxy_stats();
+  printf(" - %d concurrent requests: %u upstream, %u coalesced, %u hits\n",
+         CONCURRENT, stats.upstream, stats.coalesced, stats.hits);
+  mu_assert(s_fetches == 1, "concurrent requests for a tile should share one fetch");
+  return 0;
+}
+
+static char* test_failed_fetch_not_coalesced(void) {
+  s_fail = true;
+  s_delay_ms = 50;
+  pthread_t threads[2];
+  int results[2];
+  for (int i = 0; i < 2; i++) {
+    pthread_create(&threads[i], NULL, concurrent_get, &results[i]);
+  }
+  for (int i = 0; i < 2; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  ProxyStats stats = proxy_stats();
+  mu_assert(results[0] == -1 && results[1] == -1, "both requests should fail");
+  mu_assert(stats.upstream == 2 && stats.coalesced == 0,
+            "a request whose wait ended in a failed fetch should count as upstream only");
+  return 0;
+}
+
+static int http_exchange(const char* request, char* response, size_t size) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    return -1;
+  }
+  ssize_t sent = write(fds[0], request, strlen(request));
+  (void) sent;
+  proxy_handle_connection(fds[1]);
+  size_t used = 0;
+  ssize_t got;
+  while (used < size && (got = read(fds[0], &response[used], size - used)) > 0) {
+    used += got;
+  }
+  close(fds[0]);
+  return used;
+}
+
+static char* test_http(void) {
+  char response[2048];
+  int length = http_exchange("GET /forecast?lat=51.1279&lon=1.3134&token=" TOKEN " HTTP/1.0\r\n\r\n",
+                             response, sizeof(response));
+  mu_assert(length > 0 && strncmp(response, "HTTP/1.0 200", 12) == 0, "good request should get a 200");
+  const char* body = strstr(response, "\r\n\r\n") + 4;
+  mu_assert(body[0] == 'T' && body[1] == 'W', "body should be the payload");
+
+  http_exchange("GET /forecast?lat=51.1279&lon=1.3134&token=wrong HTTP/1.0\r\n\r\n", response, sizeof(response));
+  mu_assert(strncmp(response, "HTTP/1.0 403", 12) == 0, "wrong token should be refused");
+  http_exchange("GET /forecast?lat=51.1279&lon=1.3134&token=team%2dtoken HTTP/1.0\r\n\r\n",
+                response, sizeof(response));
+  mu_assert(strncmp(response, "HTTP/1.0 200", 12) == 0, "an encoded token should be decoded");
+  http_exchange("GET /forecast?lat=51.1279&lon=1.3134&token=team-toke HTTP/1.0\r\n\r\n",
+                response, sizeof(response));
+  mu_assert(strncmp(response, "HTTP/1.0 403", 12) == 0, "a prefix of the token should be refused");
+  http_exchange("GET /forecast?lat=91&lon=1.3134&token=" TOKEN " HTTP/1.0\r\n\r\n", response, sizeof(response));
+  mu_assert(strncmp(response, "HTTP/1.0 400", 12) == 0, "bad coordinates should be refused");
+  http_exchange("GET /stats HTTP/1.0\r\n\r\n", response, sizeof(response));
+  mu_assert(strstr(response, "\r\n\r\nrequests 2\nhits 1\n") != NULL, "stats should count the two good requests");
+  return 0;
+}
+
+static char* all_tests() {
+  mu_run_test(test_geohash);
+  mu_run_test(test_json_scan);
+  mu_run_test(test_summary_tokens_round_trip);
+  mu_run_test(test_payload_from_fixture);
+  mu_run_test(test_cache_serves_tile);
+  mu_run_test(test_failed_fetch_not_cached);
+  mu_run_test(test_concurrent_requests_coalesce);
+  mu_run_test(test_failed_fetch_not_coalesced);
+  mu_run_test(test_http);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  printf("%s----------------------------------\n", KCYN);
+  printf(" Running Forecast Proxy Test Suite \n");
+  printf("----------------------------------\n%s", KNRM);
+  if (!load_fixture()) {
+    printf("%s - Can't read %s%s\n", KRED, FIXTURE, KNRM);
+    return 1;
+  }
+  char* result = all_tests();
+  if (0 != result) {
+    printf("%s - Failed Test:%s %s\n", KRED, KNRM, result);
+  }
+  printf(" - Tests Run: %s%d%s\n", (tests_run == tests_passed) ? KGRN : KRED, tests_run, KNRM);
+  printf(" - Tests Passed: %s%d%s\n", (tests_run == tests_passed) ? KGRN : KRED, tests_passed, KNRM);
+
+  printf("%s----------------------------------%s\n", KCYN, KNRM);
+  free(s_fixture);
+  return result != 0;
+}
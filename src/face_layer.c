@@ -0,0 +1,113 @@
+#include "face_layer.h"
+#include "time_service.h"
+
+typedef struct {
+  GRect box;
+  GFont font;
+  GTextAlignment alignment;
+  const char* text;
+} Region;
+
+typedef struct {
+  Region regions[FaceRegionCount];
+  GColor text_colour;
+  GColor background;
+  uint8_t dirty;
+  uint16_t worst_draw_ms;
+} FaceLayerData;
+
+#define ALL_REGIONS ((1 << FaceRegionCount) - 1)
+
+static bool boxes_overlap(GRect a, GRect b) {
+  return a.origin.x < b.origin.x + b.size.w && b.origin.x < a.origin.x + a.size.w &&
+         a.origin.y < b.origin.y + b.size.h && b.origin.y < a.origin.y + a.size.h;
+}
+
+// Clearing a region wipes any part of a neighbour that shares its pixels, so
+// that neighbour has to be drawn again too, and so on along the chain.
+static uint8_t with_overlapping(const FaceLayerData* data, uint8_t dirty) {
+  uint8_t grown;
+  do {
+    grown = dirty;
+    for (int i = 0; i < FaceRegionCount; i++) {
+      for (int j = 0; j < FaceRegionCount; j++) {
+        if ((dirty & (1 << i)) && i != j && boxes_overlap(data->regions[i].box, data->regions[j].box)) {
+          dirty |= 1 << j;
+        }
+      }
+    }
+  } while (dirty != grown);
+  return dirty;
+}
+
+// The window behind us has a clear background, so the framebuffer keeps the
+// last frame and only the regions whose text changed need repainting.
+static void update_proc(Layer* layer, GContext* ctx) {
+  FaceLayerData* data = layer_get_data(layer);
+  uint32_t start = time_service_now_ms();
+  data->dirty = with_overlapping(data, data->dirty);
+
+  graphics_context_set_fill_color(ctx, data->background);
+  graphics_context_set_text_color(ctx, data->text_colour);
+  for (int i = 0; i < FaceRegionCount; i++) {
+    if (!(data->dirty & (1 << i))) {
+      continue;
+    }
+    Region* region = &data->regions[i];
+    graphics_fill_rect(ctx, region->box, 0, GCornerNone);
+    if (region->text && region->font) {
+      graphics_draw_text(ctx, region->text, region->font, region->box,
+                         GTextOverflowModeWordWrap, region->alignment, NULL);
+    }
+  }
+
+  uint16_t elapsed = time_service_now_ms() - start;
+  if (elapsed > data->worst_draw_ms) {
+    data->worst_draw_ms = elapsed;
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "face draw %d ms (regions 0x%x)", elapsed, data->dirty);
+  }
+  data->dirty = 0;
+}
+
+FaceLayer* face_layer_create(GRect frame, GColor text_colour, GColor background) {
+  Layer* layer = layer_create_with_data(frame, sizeof(FaceLayerData));
+  FaceLayerData* data = layer_get_data(layer);
+  memset(data, 0, sizeof(FaceLayerData));
+  data->text_colour = text_colour;
+  data->background = background;
+  data->dirty = ALL_REGIONS;
+  layer_set_update_proc(layer, update_proc);
+  return layer;
+}
+
+void face_layer_destroy(FaceLayer* face) {
+  layer_destroy(face);
+}
+
+Layer* face_layer_get_layer(FaceLayer* face) {
+  return face;
+}
+
+void face_layer_set_region(FaceLayer* face, FaceRegion region, GRect box, GFont font, GTextAlignment alignment) {
+  FaceLayerData* data = layer_get_data(face);
+  data->regions[region].box = box;
+  data->regions[region].font = font;
+  data->regions[region].alignment = alignment;
+  data->dirty |= 1 << region;
+  layer_mark_dirty(face);
+}
+
+// Like text_layer_set_text(), the text is not copied and must outlive the layer.
+void face_layer_set_text(FaceLayer* face, FaceRegion region, const char* text) {
+  FaceLayerData* data = layer_get_data(face);
+  data->regions[region].text = text;
+  data->dirty |= 1 << region;
+  layer_mark_dirty(face);
+}
+
+// For when something else has drawn over us, e.g. after a notification.
+void face_layer_mark_all_dirty(FaceLayer* face) {
+  FaceLayerData* data = layer_get_data(face);
+  data->dirty = ALL_REGIONS;
+  layer_mark_dirty(face);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <pebble.h>
+
+// One Layer that draws the weather line, time phrase and date itself,
+// standing in for three TextLayers.
+typedef Layer FaceLayer;
+
+typedef enum {
+  FaceRegionWeather = 0,
+  FaceRegionTime,
+  FaceRegionDate,
+  FaceRegionCount
+} FaceRegion;
+
+FaceLayer* face_layer_create(GRect frame, GColor text_colour, GColor background);
+void face_layer_destroy(FaceLayer* face);
+Layer* face_layer_get_layer(FaceLayer* face);
+void face_layer_set_region(FaceLayer* face, FaceRegion region, GRect box, GFont font, GTextAlignment alignment);
+void face_layer_set_text(FaceLayer* face, FaceRegion region, const char* text);
+void face_layer_mark_all_dirty(FaceLayer* face);
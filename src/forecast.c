@@ -0,0 +1,80 @@
+#include "forecast.h"
+#include "storage.h"
+
+#define SECONDS_PER_FORECAST_HOUR 3600
+
+// Transfer layout, little-endian:
+//   kind (1), start (4), count (1), then per hour
+//   temperature (1, signed), wind speed (1), bearing / 2 (1),
+//   summary length (1), summary bytes (no terminator)
+bool forecast_decode(const uint8_t* data, uint16_t length, Forecast* forecast) {
+  if (length < 6 || data[0] != TRANSFER_KIND_HOURLY) {
+    return false;
+  }
+  memset(forecast, 0, sizeof(Forecast));
+  forecast->start = data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t) data[4] << 24);
+  uint8_t count = data[5];
+
+  uint16_t offset = 6;
+  for (uint8_t i = 0; i < count; i++) {
+    if (offset + 4 > length) {
+      return false;
+    }
+    uint8_t summary_length = data[offset + 3];
+    if (offset + 4 + summary_length > length) {
+      return false;
+    }
+    // Anything past what we can hold is still walked over so a bad length is caught.
+    if (i < FORECAST_HOURS) {
+      ForecastHour* hour = &forecast->hours[i];
+      hour->temperature = (int8_t) data[offset];
+      hour->wind_speed = data[offset + 1];
+      hour->wind_bearing_half = data[offset + 2];
+      uint8_t copy = summary_length < FORECAST_SUMMARY_SIZE ? summary_length : FORECAST_SUMMARY_SIZE - 1;
+      memcpy(hour->summary, &data[offset + 4], copy);
+      forecast->count = i + 1;
+    }
+    offset += 4 + summary_length;
+  }
+  return offset == length;
+}
+
+// The hour covering "when", or NULL if the forecast doesn't reach it.
+const ForecastHour* forecast_hour_at(const Forecast* forecast, time_t when, time_t* hour_start) {
+  if (forecast->count == 0 || when < (time_t) forecast->start) {
+    return NULL;
+  }
+  uint32_t index = (when - forecast->start) / SECONDS_PER_FORECAST_HOUR;
+  if (index >= forecast->count) {
+    return NULL;
+  }
+  if (hour_start) {
+    *hour_start = forecast->start + index * SECONDS_PER_FORECAST_HOUR;
+  }
+  return &forecast->hours[index];
+}
+
+// Whole hours of forecast remaining after the one covering "when".
+int forecast_hours_left(const Forecast* forecast, time_t when) {
+  if (forecast->count == 0) {
+    return 0;
+  }
+  time_t end = forecast->start + forecast->count * SECONDS_PER_FORECAST_HOUR;
+  if (when >= end) {
+    return 0;
+  }
+  if (when < (time_t) forecast->start) {
+    return forecast->count;
+  }
+  return (end - when) / SECONDS_PER_FORECAST_HOUR;
+}
+
+void forecast_load(Forecast* forecast) {
+  if (!storage_read(StorageForecast, forecast, sizeof(Forecast))) {
+    memset(forecast, 0, sizeof(Forecast));
+  }
+}
+
+void forecast_save(const Forecast* forecast) {
+  storage_write(StorageForecast, forecast, sizeof(Forecast), StorageChangeMajor);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <pebble.h>
+
+#define FORECAST_HOURS 12
+#define FORECAST_SUMMARY_SIZE 16
+
+// First byte of a transfer saying what it holds.
+#define TRANSFER_KIND_HOURLY 1
+
+// The next few hours of forecast, kept in storage.h's blob so the face can
+// move through them on its own while the phone is out of reach.
+typedef struct __attribute__((__packed__)) {
+  int8_t temperature;
+  uint8_t wind_speed;
+  uint8_t wind_bearing_half;  // degrees / 2, to fit a byte
+  char summary[FORECAST_SUMMARY_SIZE];
+} ForecastHour;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t start;  // epoch seconds at the start of the first hour
+  uint8_t count;
+  ForecastHour hours[FORECAST_HOURS];
+} Forecast;
+
+bool forecast_decode(const uint8_t* data, uint16_t length, Forecast* forecast);
+const ForecastHour* forecast_hour_at(const Forecast* forecast, time_t when, time_t* hour_start);
+int forecast_hours_left(const Forecast* forecast, time_t when);
+void forecast_load(Forecast* forecast);
+void forecast_save(const Forecast* forecast);
@@ -1,30 +1,151 @@
-function HTTPGET(url) {
+//------ERRORS------
+// Reported to the watch under WEATHER_ERROR_KEY; see WeatherError in weather_state.h.
+var WEATHER_ERROR_KEY = 7;
+var ERROR_LOCATION = 1;
+var ERROR_TIMEOUT = 2;
+var ERROR_HTTP = 3;
+var ERROR_PARSE = 4;
+var ERROR_NO_KEY = 5;
+
+function sendError(err) {
+  console.warn('weather error (' + err.code + '): ' + err.message);
+  var dict = {};
+  dict[WEATHER_ERROR_KEY] = err.code;
+  Pebble.sendAppMessage(dict);
+}
+
+//------HTTP------
+var HTTP_TIMEOUT_MS = 15000;
+
+// Calls back exactly once, with either an error or the response text, or
+// the bytes of the response if binary is set.
+function HTTPGET(url, callback, binary) {
   var req = new XMLHttpRequest();
-  req.open("GET", url, false);
+  var finished = false;
+  var timer;
+
+  function finish(err, text) {
+    if (finished) {
+      return;
+    }
+    finished = true;
+    clearTimeout(timer);
+    callback(err, text);
+  }
+
+  timer = setTimeout(function() {
+    req.abort();
+    finish({ "code": ERROR_TIMEOUT, "message": "no response after " + HTTP_TIMEOUT_MS + "ms" });
+  }, HTTP_TIMEOUT_MS);
+
+  req.onload = function() {
+    if (req.status >= 200 && req.status < 300) {
+      finish(null, binary ? new Uint8Array(req.response) : req.responseText);
+    } else {
+      finish({ "code": ERROR_HTTP, "message": "HTTP " + req.status });
+    }
+  };
+  req.onerror = function() {
+    finish({ "code": ERROR_HTTP, "message": "network error" });
+  };
+
+  req.open("GET", url, true);
+  if (binary) {
+    req.responseType = "arraybuffer";
+  }
   req.send(null);
-  return req.responseText;
 }
 
 //------LOCATION------
 var getLocation = function() {
   //Get Location
-  window.navigator.geolocation.getCurrentPosition(locationSuccess, locationError, locationOptions);
+  window.navigator.geolocation.getCurrentPosition(guarded(locationSuccess), guarded(locationError), locationOptions);
 }
 
 function locationSuccess(pos) {
   var coordinates = pos.coords;
-  getWeatherData(coordinates.latitude, coordinates.longitude);
+  var cell = gridCell(coordinates.latitude, coordinates.longitude);
+  saveFix(cell);
+  if (sendCachedForecast(cell)) {
+    finishRequest(null);
+    return;
+  }
+  getWeatherData(cell.latitude, cell.longitude, cell.id);
 }
 
 function locationError(err) {
-  console.warn('location error (' + err.code + '): ' + err.message);
-  Pebble.sendAppMessage({
-    "city":"Loc Unavailable",
-    "temperature":"N/A"
-  });
+  finishRequest({ "code": ERROR_LOCATION, "message": err.message });
+}
+
+// Happy with a fix as old as this; we only need to know which grid cell we're in.
+var LOCATION_MAX_AGE_MS = 30 * 60 * 1000;
+var locationOptions = { "timeout": 15000, "maximumAge": LOCATION_MAX_AGE_MS };
+
+//------LOCATION GRID------
+// Positions are snapped to a grid and forecasts cached per cell, so neither
+// a GPS fix nor a forecast call is needed while we stay in the same cell.
+var GRID_DEGREES = 0.05;
+var FORECAST_TTL_MS = 15 * 60 * 1000;
+
+function gridCell(latitude, longitude) {
+  var row = Math.floor(latitude / GRID_DEGREES);
+  var column = Math.floor(longitude / GRID_DEGREES);
+  // Ask for the forecast at the centre, so it suits anywhere in the cell.
+  return { "id": row + ":" + column,
+           "latitude": ((row + 0.5) * GRID_DEGREES).toFixed(4),
+           "longitude": ((column + 0.5) * GRID_DEGREES).toFixed(4) };
+}
+
+// A value that doesn't parse is dropped, so it can't fail every request.
+function loadJSON(key, fallback) {
+  try {
+    return JSON.parse(localStorage.getItem(key) || "null") || fallback;
+  } catch (ex) {
+    console.warn("dropping unreadable " + key + ": " + ex.message);
+    localStorage.removeItem(key);
+    return fallback;
+  }
 }
 
-var locationOptions = { "timeout": 15000, "maximumAge": 60000 };
+function saveFix(cell) {
+  localStorage.setItem("lastFix", JSON.stringify({ "cell": cell, "time": Date.now() }));
+}
+
+function recentFix() {
+  var fix = loadJSON("lastFix", null);
+  if (fix && Date.now() - fix.time < LOCATION_MAX_AGE_MS) {
+    return fix;
+  }
+  return null;
+}
+
+function loadForecastCache() {
+  return loadJSON("forecastCache", {});
+}
+
+function cacheForecast(cellId, dict, hourly) {
+  var cache = loadForecastCache();
+  var now = Date.now();
+  for (var id in cache) {
+    if (now - cache[id].time >= FORECAST_TTL_MS) {
+      delete cache[id];
+    }
+  }
+  cache[cellId] = { "time": now, "dict": dict, "hourly": hourly };
+  localStorage.setItem("forecastCache", JSON.stringify(cache));
+}
+
+function sendCachedForecast(cell) {
+  var entry = loadForecastCache()[cell.id];
+  if (!entry || Date.now() - entry.time >= FORECAST_TTL_MS) {
+    return false;
+  }
+  // console.log("using cached forecast for " + cell.id);
+  sendWeather(entry.dict, function() {
+    sendHourly(entry.hourly);
+  });
+  return true;
+}
 
 //------Utility-------
 function evenRound(num, decimalPlaces) {
@@ -38,45 +159,613 @@ function evenRound(num, decimalPlaces) {
     return d ? r / m : r;
 }
 
+//------SYNC------
+// Only keys that changed since the last dictionary the watch acknowledged
+// are sent, numbered so the watch can ask for a full resync if one is lost.
+var SEQUENCE_KEY = 5;
+var FULL_UPDATE_KEY = 6;
+
+var syncState = JSON.parse(localStorage.getItem("syncState") || "null") ||
+                { "sequence": 0, "acked": null };
+
+function saveSyncState() {
+  localStorage.setItem("syncState", JSON.stringify(syncState));
+}
+
+function resync() {
+  syncState.acked = null;
+  saveSyncState();
+  localStorage.removeItem("lastHourly");
+}
+
+// done is called once the watch has the dictionary, or it failed to arrive.
+function sendWeather(dict, done) {
+  done = done || function() {};
+  var full = syncState.acked === null;
+  var delta = {};
+  for (var key in dict) {
+    // Summaries are token arrays, so compare by value.
+    if (full || JSON.stringify(syncState.acked[key]) !== JSON.stringify(dict[key])) {
+      delta[key] = dict[key];
+    }
+  }
+  // Even with nothing changed the sequence number goes, as the answer to the
+  // watch's request: it tells the watch its live values are still current.
+
+  var sequence = syncState.sequence + 1;
+  delta[SEQUENCE_KEY] = sequence;
+  if (full) {
+    delta[FULL_UPDATE_KEY] = 1;
+  }
+
+  // Send data to watch for display
+  Pebble.sendAppMessage(delta, function(e) {
+    var acked = {};
+    var key;
+    for (key in syncState.acked) {
+      acked[key] = syncState.acked[key];
+    }
+    for (key in dict) {
+      acked[key] = dict[key];
+    }
+    syncState.acked = acked;
+    syncState.sequence = sequence;
+    saveSyncState();
+    done();
+    }, function(e) {
+      // Leave the baseline alone so the next delta covers this one too.
+      // console.log("fail");
+      done();
+  });
+}
+
+//------CHUNKED TRANSFER------
+// Payloads too big for one AppMessage are sent as numbered chunks, which the
+// watch reassembles and asks for again if one goes missing. The sizes must
+// match src/transfer.h.
+var TRANSFER_ID_KEY = 8;
+var TRANSFER_CHUNK_KEY = 9;
+var TRANSFER_LENGTH_KEY = 10;
+var TRANSFER_DATA_KEY = 11;
+var TRANSFER_CHUNK_SIZE = 512;
+var TRANSFER_BUFFER_SIZE = 4096;
+
+var nextTransferId = Math.floor(Math.random() * 65535) + 1;
+// Kept so chunks can be resent when the watch asks.
+var lastTransfer = null;
+
+function chunkMessage(transfer, index) {
+  var dict = {};
+  dict[TRANSFER_ID_KEY] = transfer.id;
+  dict[TRANSFER_CHUNK_KEY] = index;
+  dict[TRANSFER_LENGTH_KEY] = transfer.bytes.length;
+  dict[TRANSFER_DATA_KEY] = transfer.bytes.slice(index * TRANSFER_CHUNK_SIZE,
+                                                 (index + 1) * TRANSFER_CHUNK_SIZE);
+  return dict;
+}
+
+function sendChunk(transfer, index) {
+  function next() {
+    if (index + 1 < transfer.chunks) {
+      sendChunk(transfer, index + 1);
+    } else {
+      var seconds = Math.max(Date.now() - transfer.started, 1) / 1000;
+      console.log("transfer " + transfer.id + ": " + transfer.bytes.length + " bytes at " +
+                  Math.round(transfer.bytes.length / seconds) + " bytes/sec");
+    }
+  }
+  // Carry on after a failure too; the watch spots the gap and asks again.
+  Pebble.sendAppMessage(chunkMessage(transfer, index), next, next);
+}
+
+// bytes is an array of numbers 0-255.
+function sendTransfer(bytes) {
+  if (bytes.length === 0 || bytes.length > TRANSFER_BUFFER_SIZE) {
+    console.warn("can't transfer " + bytes.length + " bytes");
+    return;
+  }
+  var transfer = { "id": nextTransferId,
+                   "bytes": bytes,
+                   "chunks": Math.ceil(bytes.length / TRANSFER_CHUNK_SIZE),
+                   "started": Date.now() };
+  nextTransferId = nextTransferId % 65535 + 1;
+  lastTransfer = transfer;
+  sendChunk(transfer, 0);
+}
+
+//------HOURLY FORECAST------
+// The next twelve hours go to the watch in one transfer so it can keep
+// showing a forecast without polling. The layout must match src/forecast.c.
+var TRANSFER_KIND_HOURLY = 1;
+var FORECAST_HOURS = 12;
+var FORECAST_SUMMARY_MAX = 15;
+
+function encodeHourly(hours) {
+  var count = Math.min(hours.length, FORECAST_HOURS);
+  var start = count > 0 ? hours[0].time : 0;
+  var bytes = [ TRANSFER_KIND_HOURLY,
+                start & 0xff, (start >>> 8) & 0xff, (start >>> 16) & 0xff, (start >>> 24) & 0xff,
+                count ];
+  for (var i = 0; i < count; i++) {
+    var hour = hours[i];
+    var temperature = Math.max(-128, Math.min(127, evenRound(hour.apparentTemperature)));
+    var summary = (hour.summary || "").replace(/[^\x20-\x7e]/g, "").slice(0, FORECAST_SUMMARY_MAX);
+    bytes.push(temperature & 0xff,
+               Math.min(255, evenRound(hour.windSpeed)),
+               Math.floor((hour.windBearing || 0) / 2) & 0xff,
+               summary.length);
+    for (var c = 0; c < summary.length; c++) {
+      bytes.push(summary.charCodeAt(c));
+    }
+  }
+  return bytes;
+}
+
+// Skips the transfer when the watch already has this exact forecast.
+function sendHourly(bytes) {
+  if (!bytes || bytes.length === 0) {
+    return;
+  }
+  var key = bytes.join(",");
+  if (localStorage.getItem("lastHourly") === key) {
+    return;
+  }
+  localStorage.setItem("lastHourly", key);
+  sendTransfer(bytes);
+}
+
+function resendChunk(id, index) {
+  if (lastTransfer && lastTransfer.id === id && index < lastTransfer.chunks) {
+    Pebble.sendAppMessage(chunkMessage(lastTransfer, index));
+  }
+}
+
+//------SUMMARY WORDS------
+// Summaries go to the watch as tokens against this word list, which must
+// match src/summary_words.h; only ever add words to the end of it.
+var SUMMARY_WORDS = [
+  "rain", "light", "heavy", "drizzle", "snow", "sleet", "flurries", "possible",
+  "starting", "stopping", "again", "in", "for", "the", "hour", "min",
+  "and", "then", "clear", "cloudy", "partly", "mostly", "overcast", "humid",
+  "breezy", "windy", "foggy", "dry", "precipitation", "later", "until", "this",
+  "morning", "afternoon", "evening", "tonight", "continuing", "throughout", "day", "showers",
+  "thunderstorms", "ending", "sprinkles", "dangerously", "mixed", "with", "on", "off",
+  "at", "least"
+];
+var SUMMARY_TOKEN_WORD = 0x80;
+var SUMMARY_TOKEN_CAPITAL = 0x01;
+var SUMMARY_TOKEN_ESCAPE = 0x02;
+
+function pushLiteral(tokens, text) {
+  var bytes = unescape(encodeURIComponent(text));  // UTF-8
+  for (var i = 0; i < bytes.length; i++) {
+    var b = bytes.charCodeAt(i);
+    if (b >= SUMMARY_TOKEN_WORD || b === SUMMARY_TOKEN_CAPITAL || b === SUMMARY_TOKEN_ESCAPE) {
+      tokens.push(SUMMARY_TOKEN_ESCAPE);
+    }
+    tokens.push(b);
+  }
+}
+
+// A word token brings its own leading space, so each space-separated piece
+// that starts with a known word drops the space before it.
+function encodeSummary(text) {
+  var tokens = [];
+  var pieces = text.trim().split(" ");
+  for (var i = 0; i < pieces.length; i++) {
+    var match = /^([A-Za-z]+)(.*)$/.exec(pieces[i]);
+    var word = match ? match[1] : "";
+    var lower = word.toLowerCase();
+    var index = SUMMARY_WORDS.indexOf(lower);
+    var capital = word !== lower && word === lower.charAt(0).toUpperCase() + lower.slice(1);
+    if (index < 0 || (word !== lower && !capital)) {
+      pushLiteral(tokens, (i > 0 ? " " : "") + pieces[i]);
+      continue;
+    }
+    if (capital) {
+      tokens.push(SUMMARY_TOKEN_CAPITAL);
+    }
+    tokens.push(SUMMARY_TOKEN_WORD + index);
+    pushLiteral(tokens, match[2]);
+  }
+  return tokens;
+}
+
+//------PRECIPITATION------
+// The next hour of rain goes to the watch so it can time its own alert for
+// when it starts. The layout must match src/precipitation.h.
+var PRECIPITATION_KEY = 14;
+var PRECIPITATION_MINUTES = 61;
+// Minutes less likely than this to see rain are sent as dry.
+var PRECIPITATION_MIN_PROBABILITY = 0.5;
+
+function encodePrecipitation(minutes) {
+  var start = minutes.length > 0 ? minutes[0].time : 0;
+  var bytes = [ start & 0xff, (start >>> 8) & 0xff, (start >>> 16) & 0xff, (start >>> 24) & 0xff ];
+  for (var i = 0; i < minutes.length && i < PRECIPITATION_MINUTES; i++) {
+    var minute = minutes[i];
+    var likely = (minute.precipProbability || 0) >= PRECIPITATION_MIN_PROBABILITY;
+    bytes.push(likely ? Math.min(255, evenRound((minute.precipIntensity || 0) * 20)) : 0);
+  }
+  return bytes;
+}
+
+//------FORECAST PARSING------
+// Pulls out just the parts of the forecast the watch uses, rather than
+// building objects for the whole document with JSON.parse().
+
+// Index of the value for "key", searching from "from", or -1.
+function findValue(text, key, from) {
+  var marker = '"' + key + '":';
+  var at = text.indexOf(marker, from || 0);
+  if (at < 0) {
+    return -1;
+  }
+  at += marker.length;
+  while (at < text.length && " \t\r\n".indexOf(text.charAt(at)) >= 0) {
+    at++;
+  }
+  return at;
+}
+
+// Index just past the object, array or string starting at "start".
+function valueEnd(text, start) {
+  var depth = 0;
+  var inString = false;
+  for (var i = start; i < text.length; i++) {
+    var c = text.charAt(i);
+    if (inString) {
+      if (c === "\\") {
+        i++;
+      } else if (c === '"') {
+        inString = false;
+        if (depth === 0) {
+          return i + 1;
+        }
+      }
+    } else if (c === '"') {
+      inString = true;
+    } else if (c === "{" || c === "[") {
+      depth++;
+    } else if (c === "}" || c === "]") {
+      depth--;
+      if (depth === 0) {
+        return i + 1;
+      }
+    }
+  }
+  throw new Error("truncated forecast");
+}
+
+function parseValueAt(text, start) {
+  if (start < 0) {
+    throw new Error("field missing from forecast");
+  }
+  return JSON.parse(text.slice(start, valueEnd(text, start)));
+}
+
+// Parses the object starting at "start", returning it and the index just
+// past it. Data points are flat, so the first "}" normally closes one and
+// indexOf() finds it far faster than walking the text; if that slice isn't
+// the whole object (a brace in a string, a nested object) it won't parse,
+// and the object is walked properly instead.
+function parseObjectAt(text, start) {
+  var end = text.indexOf("}", start) + 1;
+  try {
+    return { "value": JSON.parse(text.slice(start, end)), "end": end };
+  } catch (ex) {
+    end = valueEnd(text, start);
+    return { "value": JSON.parse(text.slice(start, end)), "end": end };
+  }
+}
+
+function skipSpace(text, at) {
+  while (at < text.length && " \t\r\n".indexOf(text.charAt(at)) >= 0) {
+    at++;
+  }
+  return at;
+}
+
+// The first "limit" objects of the array starting at "arrayAt". Stops there,
+// so the rest of the array is never looked at.
+function parseItems(text, arrayAt, limit) {
+  if (text.charAt(arrayAt) !== "[") {
+    throw new Error("forecast data isn't an array");
+  }
+  // Usually every point is flat: hop from "}" to "}" and parse the lot in
+  // one go. If that slice doesn't parse, take the items one at a time.
+  var end = arrayAt;
+  for (var n = 0; n < limit && end >= 0; n++) {
+    end = text.indexOf("}", end + 1);
+  }
+  if (end >= 0) {
+    try {
+      var span = JSON.parse(text.slice(arrayAt, end + 1) + "]");
+      if (span.length === limit) {
+        return span;
+      }
+    } catch (ex) {
+      // Fall through.
+    }
+  }
+
+  var items = [];
+  var at = skipSpace(text, arrayAt + 1);
+  while (items.length < limit && text.charAt(at) === "{") {
+    var item = parseObjectAt(text, at);
+    items.push(item.value);
+    at = skipSpace(text, item.end);
+    if (text.charAt(at) === ",") {
+      at = skipSpace(text, at + 1);
+    }
+  }
+  if (items.length < limit && text.charAt(at) !== "]") {
+    throw new Error("truncated forecast");
+  }
+  return items;
+}
+
+// Whether "at" is inside the object starting at "objectAt", walking only the
+// text between them. The fields we look for come before each block's data,
+// so this stays short.
+function withinObject(text, objectAt, at) {
+  if (at < 0) {
+    return false;
+  }
+  var depth = 0;
+  var inString = false;
+  for (var i = objectAt; i < at; i++) {
+    var c = text.charAt(i);
+    if (inString) {
+      if (c === "\\") {
+        i++;
+      } else if (c === '"') {
+        inString = false;
+      }
+    } else if (c === '"') {
+      inString = true;
+    } else if (c === "{" || c === "[") {
+      depth++;
+    } else if ((c === "}" || c === "]") && --depth === 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+function projectForecast(text) {
+  var currentlyAt = findValue(text, "currently");
+  if (currentlyAt < 0) {
+    throw new Error("field missing from forecast");
+  }
+  var currently = parseObjectAt(text, currentlyAt).value;
+
+  var minutelyAt = findValue(text, "minutely");
+  if (minutelyAt < 0) {
+    throw new Error("field missing from forecast");
+  }
+  // Minutely data points have no summary, so the first one found is the block's.
+  var summaryAt = findValue(text, "summary", minutelyAt);
+  var dataAt = findValue(text, "data", minutelyAt);
+  if (!withinObject(text, minutelyAt, summaryAt) || !withinObject(text, minutelyAt, dataAt)) {
+    throw new Error("minutely block incomplete");
+  }
+
+  var hourlyAt = findValue(text, "hourly");
+  if (hourlyAt < 0) {
+    throw new Error("field missing from forecast");
+  }
+  var hourlyDataAt = findValue(text, "data", hourlyAt);
+  if (!withinObject(text, hourlyAt, hourlyDataAt)) {
+    throw new Error("hourly block incomplete");
+  }
+  return {
+    "currently": currently,
+    "hourly": parseItems(text, hourlyDataAt, FORECAST_HOURS),
+    "minutely": {
+      "summary": parseValueAt(text, summaryAt),
+      "data": parseItems(text, dataAt, PRECIPITATION_MINUTES)
+    }
+  };
+}
+
 //------WEATHER------
-var api_key;
+// Sent by the watch once per session rather than with every request, and
+// kept here so a restarted phone app doesn't need it again.
+var api_key = localStorage.getItem("apiKey");
+
+// Set to a proxy/ server to share forecasts across a team; the watch's
+// secret.h then holds the proxy's token rather than the API key.
+var PROXY_URL = "";
 
-var getWeatherData = function(latitude, longitude) {
+function deliverForecast(cellId, dict, hourly) {
+  try {
+    cacheForecast(cellId, dict, hourly);
+  } catch (ex) {
+    // Out of localStorage, most likely; the watch still gets this one.
+    console.warn("couldn't cache forecast: " + ex.message);
+  }
+  sendWeather(dict, function() {
+    sendHourly(hourly);
+  });
+  finishRequest(null);
+}
+
+// The proxy does the parsing and encoding; see proxy/payload.h.
+function decodeProxyPayload(bytes) {
+  if (bytes.length < 12 || bytes[0] !== 0x54 || bytes[1] !== 0x57 || bytes[2] !== 1) {
+    throw new Error("not a proxy payload");
+  }
+  function u16(at) {
+    return bytes[at] | (bytes[at + 1] << 8);
+  }
+  function u32(at) {
+    return (u16(at) | (u16(at + 2) << 16)) >>> 0;
+  }
+  function slice(at, length) {
+    if (at + length > bytes.length) {
+      throw new Error("proxy payload truncated");
+    }
+    return Array.prototype.slice.call(bytes, at, at + length);
+  }
+
+  var dict = { 0: (u16(3) << 16) >> 16, 1: u32(5), 3: bytes[9].toString(), 4: u16(10) };
+  var at = 12;
+  dict[2] = slice(at + 1, bytes[at]);
+  at += 1 + bytes[at];
+  dict[PRECIPITATION_KEY] = slice(at + 1, bytes[at]);
+  at += 1 + bytes[at];
+  var hourly = slice(at + 2, u16(at));
+  return { "dict": dict, "hourly": hourly };
+}
+
+function getProxyWeather(latitude, longitude, cellId) {
+  var url = PROXY_URL + "/forecast?lat=" + latitude + "&lon=" + longitude +
+            "&token=" + encodeURIComponent(api_key);
+  HTTPGET(url, guarded(function(err, bytes) {
+    if (err) {
+      finishRequest(err);
+      return;
+    }
+    var decoded;
+    try {
+      decoded = decodeProxyPayload(bytes);
+    } catch (ex) {
+      finishRequest({ "code": ERROR_PARSE, "message": ex.message });
+      return;
+    }
+    decoded.dict[12] = Math.round(parseFloat(latitude) * 10000);
+    decoded.dict[13] = Math.round(parseFloat(longitude) * 10000);
+    console.log("proxy forecast: " + bytes.length + " bytes");
+    deliverForecast(cellId, decoded.dict, decoded.hourly);
+  }), true);
+}
+
+var getWeatherData = function(latitude, longitude, cellId) {
+  if (PROXY_URL) {
+    getProxyWeather(latitude, longitude, cellId);
+    return;
+  }
   // Get weather info
   // use private server, so not to share secret key, if .pbw is public
-  var url = "https://api.forecast.io/forecast/" + api_key + "/" + latitude + "," + longitude + "?units=uk&exclude=[currently,hourly,daily,alerts,flags]"
+  var url = "https://api.forecast.io/forecast/" + api_key + "/" + latitude + "," + longitude + "?units=uk&exclude=daily,alerts,flags"
   // console.log("calling: " + url)
 
-  var response = HTTPGET(url);
+  HTTPGET(url, guarded(function(err, response) {
+    if (err) {
+      finishRequest(err);
+      return;
+    }
 
-  // Convert to JSON
-  var json = JSON.parse(response);
+    var dict;
+    var hourly;
+    var started = Date.now();
+    try {
+      // Convert to JSON
+      var json = projectForecast(response);
 
-  // Extract the data
-  var apparentTemperature = evenRound(json.currently.apparentTemperature);
-  var hourFrom            = json.minutely.data[0].time;
-  var hourSummary         = json.minutely.summary;
+      // Extract the data
+      var apparentTemperature = evenRound(json.currently.apparentTemperature);
+      var hourFrom            = json.minutely.data[0].time;
+      var hourSummary         = encodeSummary(json.minutely.summary);
 
-  var windSpeed           = evenRound(json.currently.windSpeed).toString();
-  var windBearing         = json.currently.windBearing;
+      var windSpeed           = evenRound(json.currently.windSpeed).toString();
+      var windBearing         = json.currently.windBearing;
 
-  // Construct a key-value dictionary
-  var dict = { 0: apparentTemperature, 1: hourFrom, 2: hourSummary,
-               3: windSpeed, 4: windBearing };
+      // Construct a key-value dictionary
+      // 12 and 13 let the watch work out sunrise and sunset itself.
+      dict = { 0: apparentTemperature, 1: hourFrom, 2: hourSummary,
+               3: windSpeed, 4: windBearing,
+               12: Math.round(parseFloat(latitude) * 10000),
+               13: Math.round(parseFloat(longitude) * 10000) };
+      dict[PRECIPITATION_KEY] = encodePrecipitation(json.minutely.data);
+      hourly = encodeHourly(json.hourly);
+    } catch (ex) {
+      finishRequest({ "code": ERROR_PARSE, "message": ex.message });
+      return;
+    }
+    console.log("forecast: " + response.length + " bytes, parsed in " + (Date.now() - started) + "ms");
 
-  // Send data to watch for display
-  Pebble.sendAppMessage(dict, function(e) {
-    // console.log("success");
-    }, function(e) {
-      // console.log("fail");
-  });
+    deliverForecast(cellId, dict, hourly);
+  }));
 };
 
+//------REQUESTS------
+// Only one location + forecast fetch runs at a time; requests from the watch
+// that arrive meanwhile are answered by the one already in flight.
+var requestInFlight = false;
+// Longer than a location fix and a forecast call can take between them; if
+// a request is still in flight after this, something threw and lost it.
+var REQUEST_WATCHDOG_MS = locationOptions.timeout + HTTP_TIMEOUT_MS + 5000;
+var requestWatchdog = null;
+
+// Wraps a step of the request so that an exception finishes the request
+// rather than leaving requestInFlight set for the rest of the session.
+function guarded(step) {
+  return function() {
+    try {
+      return step.apply(this, arguments);
+    } catch (ex) {
+      finishRequest({ "code": ERROR_PARSE, "message": ex.message });
+    }
+  };
+}
+
+function requestWeather() {
+  if (requestInFlight) {
+    // console.log("weather request already in flight");
+    return;
+  }
+  requestInFlight = true;
+  requestWatchdog = setTimeout(function() {
+    requestWatchdog = null;
+    finishRequest({ "code": ERROR_TIMEOUT, "message": "request lost after " + REQUEST_WATCHDOG_MS + "ms" });
+  }, REQUEST_WATCHDOG_MS);
+
+  guarded(function() {
+    var fix = recentFix();
+    if (fix && sendCachedForecast(fix.cell)) {
+      finishRequest(null);
+      return;
+    }
+    getLocation();
+  })();
+}
+
+function finishRequest(err) {
+  if (!requestInFlight) {
+    // Already finished, by the watchdog or an earlier error.
+    return;
+  }
+  requestInFlight = false;
+  clearTimeout(requestWatchdog);
+  requestWatchdog = null;
+  if (err) {
+    sendError(err);
+  }
+}
+
 //------MAIN------
 Pebble.addEventListener("appmessage",
   function(e) {
-    // Watch wants new data!
-    api_key = e.payload.meh;
-    getLocation();
+    if (e.payload.transfer !== undefined) {
+      resendChunk(e.payload.transfer, e.payload.chunk);
+      return;
+    }
+
+    // Watch wants new data! The handshake carries the key, later requests
+    // just a one-byte code.
+    if (e.payload.meh !== undefined) {
+      api_key = e.payload.meh;
+      localStorage.setItem("apiKey", api_key);
+    }
+    if (!api_key) {
+      sendError({ "code": ERROR_NO_KEY, "message": "no API key yet" });
+      return;
+    }
+    if (e.payload.resync) {
+      resync();
+    }
+    requestWeather();
   }
 );
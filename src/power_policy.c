@@ -0,0 +1,87 @@
+#include "power_policy.h"
+#include "telemetry.h"
+
+static const char* const MODE_NAMES[] = {
+  "normal",
+  "saver",
+  "critical"
+};
+
+static PowerMode s_mode = PowerModeNormal;
+static PowerModeChangedHandler s_handler = NULL;
+
+PowerMode power_policy_mode_for(BatteryChargeState charge, PowerMode current) {
+  if (charge.is_charging || charge.is_plugged) {
+    return PowerModeNormal;
+  }
+
+  int percent = charge.charge_percent;
+  if (percent <= POWER_CRITICAL_THRESHOLD) {
+    return PowerModeCritical;
+  }
+  if (current == PowerModeCritical && percent <= POWER_CRITICAL_THRESHOLD + POWER_HYSTERESIS) {
+    return PowerModeCritical;
+  }
+  if (percent <= POWER_SAVER_THRESHOLD) {
+    return PowerModeSaver;
+  }
+  if (current != PowerModeNormal && percent <= POWER_SAVER_THRESHOLD + POWER_HYSTERESIS) {
+    return PowerModeSaver;
+  }
+  return PowerModeNormal;
+}
+
+static void handle_battery(BatteryChargeState charge) {
+  telemetry_record(TelemetryBattery, charge.charge_percent, charge.is_charging);
+
+  PowerMode new_mode = power_policy_mode_for(charge, s_mode);
+  if (new_mode == s_mode) {
+    return;
+  }
+
+  PowerMode old_mode = s_mode;
+  s_mode = new_mode;
+  APP_LOG(APP_LOG_LEVEL_INFO, "power mode %s -> %s (%d%%%s)",
+          MODE_NAMES[old_mode], MODE_NAMES[new_mode], charge.charge_percent,
+          charge.is_charging ? ", charging" : "");
+  if (s_handler) {
+    s_handler(old_mode, new_mode);
+  }
+}
+
+void power_policy_init(PowerModeChangedHandler handler) {
+  s_handler = NULL;
+  s_mode = PowerModeNormal;
+  // Settle on the starting mode quietly; the face draws everything at init anyway.
+  handle_battery(battery_state_service_peek());
+  s_handler = handler;
+  battery_state_service_subscribe(handle_battery);
+}
+
+void power_policy_deinit(void) {
+  battery_state_service_unsubscribe();
+  s_handler = NULL;
+}
+
+PowerMode power_policy_mode(void) {
+  return s_mode;
+}
+
+bool power_policy_allows_weather(void) {
+  return s_mode == PowerModeNormal;
+}
+
+bool power_policy_allows_optional_redraws(void) {
+  return s_mode == PowerModeNormal;
+}
+
+bool power_policy_should_update_time(struct tm* tick_time, TimeUnits units_changed) {
+  if (s_mode != PowerModeCritical || (units_changed & HOUR_UNIT)) {
+    return true;
+  }
+  // fuzzy_time_to_words() rounds to the nearest five minutes and says how
+  // close it is, so its words change at % 5 == 3 ("nearly"), 0 (on the
+  // dot) and 1 ("just gone"), and stay put for the other two minutes.
+  int phase = tick_time->tm_min % 5;
+  return phase == 3 || phase == 0 || phase == 1;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <pebble.h>
+
+// Battery percentages at or below which the face starts cutting back.
+#define POWER_SAVER_THRESHOLD 20
+#define POWER_CRITICAL_THRESHOLD 10
+// Charge must climb this far past a threshold before we step back up, so a
+// reading wobbling between two values doesn't flip modes back and forth.
+#define POWER_HYSTERESIS 5
+
+typedef enum {
+  PowerModeNormal = 0,
+  PowerModeSaver,    // no weather polling, date line only redrawn daily
+  PowerModeCritical  // as saver, plus the fuzzy time only redrawn when its words change
+} PowerMode;
+
+typedef void (*PowerModeChangedHandler)(PowerMode old_mode, PowerMode new_mode);
+
+void power_policy_init(PowerModeChangedHandler handler);
+void power_policy_deinit(void);
+PowerMode power_policy_mode(void);
+PowerMode power_policy_mode_for(BatteryChargeState charge, PowerMode current);
+
+bool power_policy_allows_weather(void);
+bool power_policy_allows_optional_redraws(void);
+bool power_policy_should_update_time(struct tm* tick_time, TimeUnits units_changed);
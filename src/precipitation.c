@@ -0,0 +1,39 @@
+#include "precipitation.h"
+
+static time_t series_start(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static uint16_t series_minutes(uint16_t length) {
+  uint16_t count = length - PRECIPITATION_HEADER_SIZE;
+  return count > PRECIPITATION_MAX_MINUTES ? PRECIPITATION_MAX_MINUTES : count;
+}
+
+// When rain next starts after "now", or 0 if the series has no dry spell
+// turning wet after then. Rain already falling at the start doesn't count.
+time_t precipitation_next_onset(const uint8_t* data, uint16_t length, time_t now) {
+  if (length <= PRECIPITATION_HEADER_SIZE) {
+    return 0;
+  }
+  time_t start = series_start(data);
+  const uint8_t* minutes = &data[PRECIPITATION_HEADER_SIZE];
+  uint16_t count = series_minutes(length);
+
+  for (uint16_t i = 1; i < count; i++) {
+    bool starts = minutes[i] >= PRECIPITATION_RAIN_LEVEL && minutes[i - 1] < PRECIPITATION_RAIN_LEVEL;
+    time_t when = start + i * PRECIPITATION_STEP;
+    if (starts && when > now) {
+      return when;
+    }
+  }
+  return 0;
+}
+
+// When the series stops saying anything about the weather, or 0 if it never
+// did (no minutes, or no start because the phone had no minutely data).
+time_t precipitation_end(const uint8_t* data, uint16_t length) {
+  if (length <= PRECIPITATION_HEADER_SIZE || series_start(data) == 0) {
+    return 0;
+  }
+  return series_start(data) + series_minutes(length) * PRECIPITATION_STEP;
+}
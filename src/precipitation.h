@@ -0,0 +1,22 @@
+#pragma once
+
+#include <pebble.h>
+
+// The next hour of rain as sent by the phone under KEY_PRECIPITATION,
+// little-endian: start (4), then one byte per minute of intensity in
+// 0.05 mm/h steps, zero where rain is unlikely. Must match the JS.
+#define PRECIPITATION_HEADER_SIZE 4
+#define PRECIPITATION_MAX_MINUTES 61
+#define PRECIPITATION_STEP 60
+// 0.1 mm/h, the lightest drizzle worth telling anyone about.
+#define PRECIPITATION_RAIN_LEVEL 2
+
+// The last series received, kept in storage.h's blob so the alert can be
+// re-armed after the face has been closed and opened again.
+typedef struct __attribute__((__packed__)) {
+  uint8_t length;  // bytes of data in use, 0 if none
+  uint8_t data[PRECIPITATION_HEADER_SIZE + PRECIPITATION_MAX_MINUTES];
+} PrecipitationSeries;
+
+time_t precipitation_next_onset(const uint8_t* data, uint16_t length, time_t now);
+time_t precipitation_end(const uint8_t* data, uint16_t length);
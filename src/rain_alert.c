@@ -0,0 +1,87 @@
+#include "rain_alert.h"
+#include "precipitation.h"
+#include "storage.h"
+
+static RainAlertHandler s_handler = NULL;
+static AppTimer* s_timer = NULL;
+static time_t s_onset = 0;
+static PrecipitationSeries s_series;
+
+static void cancel_timer(void) {
+  if (s_timer) {
+    app_timer_cancel(s_timer);
+    s_timer = NULL;
+  }
+  s_onset = 0;
+}
+
+static void handle_onset(void* data);
+
+// Points the one timer at the next onset in the series after "after", if it
+// has one.
+static void arm(time_t after) {
+  time_t now = time(NULL);
+  time_t onset = precipitation_next_onset(s_series.data, s_series.length, after > now ? after : now);
+  if (onset == 0) {
+    cancel_timer();
+    return;
+  }
+  if (onset == s_onset) {
+    return;
+  }
+
+  uint32_t delay_ms = (uint32_t) (onset - now) * 1000;
+  if (s_timer) {
+    app_timer_reschedule(s_timer, delay_ms);
+  } else {
+    s_timer = app_timer_register(delay_ms, handle_onset, NULL);
+  }
+  s_onset = onset;
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "rain alert in %d s", (int) (onset - now));
+}
+
+static void handle_onset(void* data) {
+  s_timer = NULL;
+  time_t onset = s_onset;
+  s_onset = 0;
+  if (s_handler) {
+    s_handler(onset);
+  }
+  // The same series may have another shower in it; the timer can fire a
+  // little early, so look past this onset rather than from now.
+  arm(onset);
+}
+
+void rain_alert_init(RainAlertHandler handler) {
+  s_handler = handler;
+  if (!storage_read(StoragePrecipitation, &s_series, sizeof(s_series))) {
+    memset(&s_series, 0, sizeof(s_series));
+  }
+  arm(0);
+}
+
+void rain_alert_deinit(void) {
+  cancel_timer();
+  s_handler = NULL;
+}
+
+// Each new series replaces the last, so the timer follows the latest
+// forecast rather than the watch polling to see if it's raining yet.
+void rain_alert_update(const uint8_t* data, uint16_t length) {
+  if (length > sizeof(s_series.data)) {
+    length = sizeof(s_series.data);
+  }
+  memset(&s_series, 0, sizeof(s_series));
+  memcpy(s_series.data, data, length);
+  s_series.length = length;
+  // Losing it to a crash only costs an alert; storage_deinit() writes it on the way out.
+  storage_write(StoragePrecipitation, &s_series, sizeof(s_series), StorageChangeMinor);
+  arm(0);
+}
+
+// True while there is a series that is about to run out. A phone that sends
+// no minutely data isn't asked again for it.
+bool rain_alert_running_low(time_t now) {
+  time_t end = precipitation_end(s_series.data, s_series.length);
+  return end != 0 && end - now < RAIN_ALERT_REFRESH_SECONDS;
+}
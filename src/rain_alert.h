@@ -0,0 +1,16 @@
+#pragma once
+
+#include <pebble.h>
+
+// Called when rain is due to start, from the one timer armed for it.
+typedef void (*RainAlertHandler)(time_t onset);
+
+// Ask the phone again once the series has less than this left to run, so
+// the next one arrives before this one runs out.
+#define RAIN_ALERT_REFRESH_SECONDS (20 * 60)
+
+// Needs storage_init() first; re-arms from the series stored last time.
+void rain_alert_init(RainAlertHandler handler);
+void rain_alert_deinit(void);
+void rain_alert_update(const uint8_t* data, uint16_t length);
+bool rain_alert_running_low(time_t now);
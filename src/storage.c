@@ -0,0 +1,179 @@
+#include "storage.h"
+#include <stddef.h>
+#include "forecast.h"
+#include "precipitation.h"
+#include "sun.h"
+#include "worker_protocol.h"
+
+// Where each section used to live before they shared a blob.
+#define LEGACY_WEATHER_PERSIST_KEY 101
+#define LEGACY_FORECAST_PERSIST_KEY 102
+#define LEGACY_SUN_PERSIST_KEY 103
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t version;
+  uint16_t length;  // sizeof(StoredState), so a layout change is caught even without a version bump
+  uint8_t present;  // a bit per StorageSection that has been written
+  WeatherSnapshot weather;
+  SunCache sun;
+  Forecast forecast;
+  PrecipitationSeries precipitation;
+} StoredState;
+
+// Starts every page, so a page that is damaged, or left over from an
+// earlier flush because the watch died between writes, is noticed.
+typedef struct __attribute__((__packed__)) {
+  uint16_t checksum;   // Fletcher-16 of the rest of the page
+  uint8_t generation;  // the same in every page of one flush
+} PageHeader;
+
+#define PAGE_DATA_SIZE (PERSIST_DATA_MAX_LENGTH - sizeof(PageHeader))
+#define STORAGE_PAGES ((sizeof(StoredState) + PAGE_DATA_SIZE - 1) / PAGE_DATA_SIZE)
+
+typedef struct {
+  uint16_t offset;
+  uint16_t size;
+} Section;
+
+static const Section SECTIONS[StorageSectionCount] = {
+  [StorageWeather] = { offsetof(StoredState, weather), sizeof(WeatherSnapshot) },
+  [StorageSun] = { offsetof(StoredState, sun), sizeof(SunCache) },
+  [StorageForecast] = { offsetof(StoredState, forecast), sizeof(Forecast) },
+  [StoragePrecipitation] = { offsetof(StoredState, precipitation), sizeof(PrecipitationSeries) }
+};
+
+static StoredState s_state;
+static bool s_dirty = false;
+static bool s_major = false;
+static time_t s_last_write = 0;
+static uint8_t s_generation = 0;
+// persist_write_data() calls since storage_take_write_count() last asked.
+static uint16_t s_write_count = 0;
+
+// Bytes of the blob held under STORAGE_PERSIST_KEY + page, after its header.
+static size_t page_size(size_t page) {
+  size_t left = sizeof(StoredState) - page * PAGE_DATA_SIZE;
+  return left < PAGE_DATA_SIZE ? left : PAGE_DATA_SIZE;
+}
+
+static uint16_t page_checksum(const uint8_t* bytes, size_t size) {
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (size_t i = 0; i < size; i++) {
+    sum1 = (sum1 + bytes[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+// Copies one page into the blob, returning false unless it is whole, intact
+// and, past the first page, from the same flush as the first.
+static bool read_page(size_t page, uint8_t* generation) {
+  uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+  size_t size = sizeof(PageHeader) + page_size(page);
+  if (persist_read_data(STORAGE_PERSIST_KEY + page, buffer, size) != (int) size) {
+    return false;
+  }
+  const PageHeader* header = (const PageHeader*) buffer;
+  if (header->checksum != page_checksum(&buffer[sizeof(header->checksum)], size - sizeof(header->checksum)) ||
+      (page > 0 && header->generation != *generation)) {
+    return false;
+  }
+  *generation = header->generation;
+  memcpy((uint8_t*) &s_state + page * PAGE_DATA_SIZE, &buffer[sizeof(PageHeader)], page_size(page));
+  return true;
+}
+
+static void write_page(size_t page) {
+  uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+  size_t size = sizeof(PageHeader) + page_size(page);
+  PageHeader* header = (PageHeader*) buffer;
+  header->generation = s_generation;
+  memcpy(&buffer[sizeof(PageHeader)], (const uint8_t*) &s_state + page * PAGE_DATA_SIZE, page_size(page));
+  header->checksum = page_checksum(&buffer[sizeof(header->checksum)], size - sizeof(header->checksum));
+  persist_write_data(STORAGE_PERSIST_KEY + page, buffer, size);
+}
+
+static void reset(void) {
+  memset(&s_state, 0, sizeof(s_state));
+  s_state.version = STORAGE_VERSION;
+  s_state.length = sizeof(StoredState);
+}
+
+// One read per page, at startup only; everything after that comes from RAM.
+// Any page that doesn't check out loses the whole blob rather than mixing
+// two flushes.
+void storage_init(void) {
+  s_generation = 0;
+  for (size_t page = 0; page < STORAGE_PAGES; page++) {
+    if (!read_page(page, &s_generation)) {
+      reset();
+      break;
+    }
+  }
+  if (s_state.version != STORAGE_VERSION || s_state.length != sizeof(StoredState)) {
+    reset();
+  }
+  if (!s_state.present) {
+    // Nothing of ours yet; clear out what the old layout left behind.
+    persist_delete(LEGACY_WEATHER_PERSIST_KEY);
+    persist_delete(LEGACY_FORECAST_PERSIST_KEY);
+    persist_delete(LEGACY_SUN_PERSIST_KEY);
+  }
+  s_dirty = false;
+  s_major = false;
+  s_last_write = time(NULL);
+}
+
+void storage_deinit(void) {
+  if (s_dirty) {
+    s_major = true;
+    storage_flush(time(NULL));
+  }
+}
+
+// Copies a section out of the blob, returning false if it was never stored.
+bool storage_read(StorageSection section, void* data, size_t size) {
+  if (section >= StorageSectionCount || size != SECTIONS[section].size || !(s_state.present & (1 << section))) {
+    return false;
+  }
+  memcpy(data, (uint8_t*) &s_state + SECTIONS[section].offset, size);
+  return true;
+}
+
+// Only marks the blob dirty if the section actually changed.
+void storage_write(StorageSection section, const void* data, size_t size, StorageChange change) {
+  if (section >= StorageSectionCount || size != SECTIONS[section].size) {
+    return;
+  }
+  uint8_t* dest = (uint8_t*) &s_state + SECTIONS[section].offset;
+  if ((s_state.present & (1 << section)) && memcmp(dest, data, size) == 0) {
+    return;
+  }
+  memcpy(dest, data, size);
+  s_state.present |= 1 << section;
+  s_dirty = true;
+  s_major |= change == StorageChangeMajor;
+}
+
+// Call now and then (the minute tick will do): writes the blob if there was
+// a major change since the last write, or minor ones and the interval is up.
+void storage_flush(time_t now) {
+  if (!s_dirty || (!s_major && now - s_last_write < STORAGE_MIN_WRITE_INTERVAL)) {
+    return;
+  }
+  s_generation++;
+  for (size_t page = 0; page < STORAGE_PAGES; page++) {
+    write_page(page);
+    s_write_count++;
+  }
+  s_dirty = false;
+  s_major = false;
+  s_last_write = now;
+}
+
+uint16_t storage_take_write_count(void) {
+  uint16_t count = s_write_count;
+  s_write_count = 0;
+  return count;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <pebble.h>
+
+// The weather, sun, forecast and rain state, kept in RAM as one versioned
+// blob and written to flash in as few writes as we can get away with. The
+// blob is bigger than one persist value, so it is stored as pages on
+// consecutive keys from STORAGE_PERSIST_KEY, each checksummed and stamped
+// with the flush that wrote it.
+#define STORAGE_PERSIST_KEY 104
+#define STORAGE_VERSION 2
+// Minor changes wait at least this long for company before being written.
+#define STORAGE_MIN_WRITE_INTERVAL (30 * 60)
+
+typedef enum {
+  StorageWeather = 0,
+  StorageSun,
+  StorageForecast,
+  StoragePrecipitation,
+  StorageSectionCount
+} StorageSection;
+
+typedef enum {
+  StorageChangeMinor = 0,  // written on the interval, or on the way out
+  StorageChangeMajor       // written at the next flush
+} StorageChange;
+
+void storage_init(void);
+void storage_deinit(void);
+bool storage_read(StorageSection section, void* data, size_t size);
+void storage_write(StorageSection section, const void* data, size_t size, StorageChange change);
+void storage_flush(time_t now);
+uint16_t storage_take_write_count(void);
@@ -0,0 +1,41 @@
+#include "summary_words.h"
+
+static const char* const WORDS[] = { SUMMARY_WORDS };
+
+#define WORD_COUNT (sizeof(WORDS) / sizeof(WORDS[0]))
+
+// Expands into out, truncating to fit, and returns the length written. out is
+// always terminated. Unknown word numbers are skipped.
+size_t summary_words_expand(const uint8_t* tokens, size_t length, char* out, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  size_t used = 0;
+  bool capital = false;
+  for (size_t i = 0; i < length && used < size - 1; i++) {
+    uint8_t token = tokens[i];
+    if (token == SUMMARY_TOKEN_CAPITAL) {
+      capital = true;
+    } else if (token == SUMMARY_TOKEN_ESCAPE) {
+      if (++i < length) {
+        out[used++] = tokens[i];
+      }
+    } else if (token >= SUMMARY_TOKEN_WORD) {
+      uint8_t index = token - SUMMARY_TOKEN_WORD;
+      if (index >= WORD_COUNT) {
+        continue;
+      }
+      if (used > 0) {
+        out[used++] = ' ';
+      }
+      for (const char* c = WORDS[index]; *c && used < size - 1; c++) {
+        out[used++] = (capital && c == WORDS[index]) ? *c - 'a' + 'A' : *c;
+      }
+      capital = false;
+    } else {
+      out[used++] = token;
+    }
+  }
+  out[used] = '\0';
+  return used;
+}
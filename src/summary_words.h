@@ -0,0 +1,26 @@
+#pragma once
+
+#include <pebble.h>
+
+// Forecast summaries come from a small vocabulary, so the phone sends them as
+// a token stream against a word list compiled into both ends:
+//   0x80 + n   word n, with a space before it unless it starts the text
+//   0x01       capitalise the first letter of the next word
+//   0x02 b     byte b as is, for bytes that would otherwise be tokens
+//   anything else is a literal character
+// The word list must match SUMMARY_WORDS in src/js/pebble-js-app.js; only
+// ever add words to the end of it. The proxy encodes against it too.
+#define SUMMARY_WORDS \
+  "rain", "light", "heavy", "drizzle", "snow", "sleet", "flurries", "possible", \
+  "starting", "stopping", "again", "in", "for", "the", "hour", "min", \
+  "and", "then", "clear", "cloudy", "partly", "mostly", "overcast", "humid", \
+  "breezy", "windy", "foggy", "dry", "precipitation", "later", "until", "this", \
+  "morning", "afternoon", "evening", "tonight", "continuing", "throughout", "day", "showers", \
+  "thunderstorms", "ending", "sprinkles", "dangerously", "mixed", "with", "on", "off", \
+  "at", "least"
+
+#define SUMMARY_TOKEN_WORD 0x80
+#define SUMMARY_TOKEN_CAPITAL 0x01
+#define SUMMARY_TOKEN_ESCAPE 0x02
+
+size_t summary_words_expand(const uint8_t* tokens, size_t length, char* out, size_t size);
@@ -0,0 +1,165 @@
+#include "sun.h"
+#include "storage.h"
+
+// The sunrise equation, in integers. Angles that build up over the years are
+// binary (2^32 a turn, wrapping for free) and everything else uses the
+// TRIG_MAX_ANGLE / TRIG_MAX_RATIO scale of the lookup functions.
+#define SECONDS_PER_DAY 86400
+#define J2000 946728000  // 2000-01-01 12:00 UTC
+
+// Solar mean anomaly at J2000 and its rate per second, scaled by 2^12.
+#define MEAN_ANOMALY_J2000 4265488311u
+#define MEAN_ANOMALY_RATE 557448
+#define MEAN_ANOMALY_SHIFT 12
+// Equation of the centre, 1.9148, 0.0200 and 0.0003 degrees, binary.
+#define CENTRE_1 22844454
+#define CENTRE_2 238609
+#define CENTRE_3 3579
+// 180 degrees plus the argument of perihelion, 102.9372, binary.
+#define PERIHELION 3375572280u
+// sin of the obliquity, 23.4397 degrees, and of the -0.833 degree altitude
+// that counts as sunrise, allowing for refraction and the sun's disc.
+#define SIN_OBLIQUITY 26069
+#define SIN_SUNRISE_ALTITUDE -953
+// Largest magnitude atan2_lookup() takes.
+#define ATAN_SCALE 32767
+
+static uint32_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+static int32_t trig_angle(uint32_t binary) {
+  return binary >> 16;
+}
+
+static int32_t trig_multiple(int32_t angle, int n) {
+  return (angle * n) & (TRIG_MAX_ANGLE - 1);
+}
+
+// Day is the local calendar day counted from the Unix epoch.
+void sun_day_compute(int32_t day, int32_t latitude_e4, int32_t longitude_e4, SunDay* sun) {
+  // Mean solar noon at this longitude, in seconds from J2000.
+  int32_t noon = day * SECONDS_PER_DAY + SECONDS_PER_DAY / 2 - longitude_e4 * 3 / 125 - J2000;
+
+  uint32_t anomaly = MEAN_ANOMALY_J2000 +
+                     (uint32_t) (((int64_t) MEAN_ANOMALY_RATE * noon) >> MEAN_ANOMALY_SHIFT);
+  int32_t m = trig_angle(anomaly);
+  int32_t sin_m = sin_lookup(m);
+  int64_t centre = ((int64_t) CENTRE_1 * sin_m +
+                    (int64_t) CENTRE_2 * sin_lookup(trig_multiple(m, 2)) +
+                    (int64_t) CENTRE_3 * sin_lookup(trig_multiple(m, 3))) / TRIG_MAX_RATIO;
+  int32_t ecliptic = trig_angle(anomaly + (uint32_t) centre + PERIHELION);
+
+  // Equation of time: 0.0053 and 0.0069 of a day.
+  int32_t transit = noon + (int32_t) ((45792 * (int64_t) sin_m -
+                                        59616 * (int64_t) sin_lookup(trig_multiple(ecliptic, 2))) /
+                                       (100 * TRIG_MAX_RATIO));
+
+  int32_t sin_declination = sin_lookup(ecliptic) * SIN_OBLIQUITY / TRIG_MAX_RATIO;
+  int32_t cos_declination = isqrt((uint32_t) TRIG_MAX_RATIO * TRIG_MAX_RATIO -
+                                  (uint32_t) (sin_declination * sin_declination));
+  int32_t latitude = (int32_t) ((int64_t) latitude_e4 * TRIG_MAX_ANGLE / 3600000);
+  int32_t sin_latitude = sin_lookup(latitude);
+  int32_t cos_latitude = cos_lookup(latitude);
+
+  // cos of the hour angle at sunrise, as a ratio of these two.
+  int64_t numerator = (int64_t) SIN_SUNRISE_ALTITUDE * TRIG_MAX_RATIO -
+                      (int64_t) sin_latitude * sin_declination;
+  int64_t denominator = (int64_t) cos_latitude * cos_declination;
+  if (numerator >= denominator) {
+    sun->state = SunAlwaysDown;
+  } else if (numerator <= -denominator) {
+    sun->state = SunAlwaysUp;
+  } else {
+    sun->state = SunRisesAndSets;
+  }
+  if (sun->state != SunRisesAndSets) {
+    sun->sunrise = sun->sunset = transit + J2000;
+    return;
+  }
+
+  int32_t cos_hour = (int32_t) (numerator * ATAN_SCALE / denominator);
+  int32_t sin_hour = isqrt(ATAN_SCALE * ATAN_SCALE - cos_hour * cos_hour);
+  int32_t hour_angle = atan2_lookup(sin_hour, cos_hour);
+  int32_t half_day = (int32_t) ((int64_t) hour_angle * SECONDS_PER_DAY / TRIG_MAX_ANGLE);
+  sun->sunrise = transit - half_day + J2000;
+  sun->sunset = transit + half_day + J2000;
+}
+
+// Returns whether the position changed, in which case the cached days are dropped.
+bool sun_cache_set_location(SunCache* cache, int32_t latitude_e4, int32_t longitude_e4) {
+  if (cache->have_location && cache->latitude_e4 == latitude_e4 && cache->longitude_e4 == longitude_e4) {
+    return false;
+  }
+  cache->have_location = true;
+  cache->latitude_e4 = latitude_e4;
+  cache->longitude_e4 = longitude_e4;
+  cache->day = -1;
+  return true;
+}
+
+// Returns whether anything was worked out, so the caller knows to save.
+bool sun_cache_update(SunCache* cache, int32_t day) {
+  if (!cache->have_location || cache->day == day) {
+    return false;
+  }
+  if (cache->day + 1 == day) {
+    cache->today = cache->tomorrow;
+  } else {
+    sun_day_compute(day, cache->latitude_e4, cache->longitude_e4, &cache->today);
+  }
+  sun_day_compute(day + 1, cache->latitude_e4, cache->longitude_e4, &cache->tomorrow);
+  cache->day = day;
+  return true;
+}
+
+// The next sunrise or sunset after "now" out of the two cached days.
+bool sun_cache_next_event(const SunCache* cache, time_t now, time_t* when, bool* sunrise) {
+  if (cache->day < 0) {
+    return false;
+  }
+  const SunDay* days[] = { &cache->today, &cache->tomorrow };
+  for (int i = 0; i < 2; i++) {
+    const SunDay* sun = days[i];
+    if (sun->state != SunRisesAndSets) {
+      continue;
+    }
+    if (now < (time_t) sun->sunrise) {
+      *when = sun->sunrise;
+      *sunrise = true;
+      return true;
+    }
+    if (now < (time_t) sun->sunset) {
+      *when = sun->sunset;
+      *sunrise = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+void sun_cache_load(SunCache* cache) {
+  if (!storage_read(StorageSun, cache, sizeof(SunCache))) {
+    memset(cache, 0, sizeof(SunCache));
+    cache->day = -1;
+  }
+}
+
+void sun_cache_save(const SunCache* cache) {
+  // Cheap to work out again, so it can wait for the next write.
+  storage_write(StorageSun, cache, sizeof(SunCache), StorageChangeMinor);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <pebble.h>
+
+typedef enum {
+  SunRisesAndSets = 0,
+  SunAlwaysUp,
+  SunAlwaysDown
+} SunState;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t sunrise;
+  uint32_t sunset;
+  uint8_t state;  // SunState
+} SunDay;
+
+// Sunrise and sunset for today and tomorrow at the last known position,
+// worked out once a day and kept in storage.h's blob. Coordinates are in
+// ten-thousandths of a degree, as sent by the phone.
+typedef struct __attribute__((__packed__)) {
+  bool have_location;
+  int32_t latitude_e4;
+  int32_t longitude_e4;
+  int32_t day;  // local days since the epoch that "today" is for, -1 if none
+  SunDay today;
+  SunDay tomorrow;
+} SunCache;
+
+void sun_day_compute(int32_t day, int32_t latitude_e4, int32_t longitude_e4, SunDay* sun);
+bool sun_cache_set_location(SunCache* cache, int32_t latitude_e4, int32_t longitude_e4);
+bool sun_cache_update(SunCache* cache, int32_t day);
+bool sun_cache_next_event(const SunCache* cache, time_t now, time_t* when, bool* sunrise);
+void sun_cache_load(SunCache* cache);
+void sun_cache_save(const SunCache* cache);
@@ -0,0 +1,48 @@
+#include "telemetry.h"
+
+static DataLoggingSessionRef s_session = NULL;
+static TelemetryRecord s_batch[TELEMETRY_BATCH_SIZE];
+static uint8_t s_count = 0;
+
+void telemetry_init(void) {
+  s_count = 0;
+  // Resume so records from earlier runs end up in the same session.
+  s_session = data_logging_create(TELEMETRY_TAG, DATA_LOGGING_BYTE_ARRAY, sizeof(TelemetryRecord), true);
+}
+
+void telemetry_deinit(void) {
+  telemetry_flush();
+  if (s_session) {
+    data_logging_finish(s_session);
+    s_session = NULL;
+  }
+}
+
+void telemetry_record(TelemetryKind kind, int32_t value, uint16_t aux) {
+  // Without data logging there is nowhere for the batch to go.
+  if (!s_session) {
+    return;
+  }
+  s_batch[s_count++] = (TelemetryRecord) {
+    .timestamp = (uint32_t) time(NULL),
+    .kind = kind,
+    .aux = aux,
+    .value = value
+  };
+  if (s_count == TELEMETRY_BATCH_SIZE) {
+    telemetry_flush();
+  }
+}
+
+void telemetry_flush(void) {
+  if (s_count == 0) {
+    return;
+  }
+  DataLoggingResult result = s_session ? data_logging_log(s_session, s_batch, s_count) : DATA_LOGGING_NOT_FOUND;
+  if (result != DATA_LOGGING_SUCCESS) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "telemetry flush failed: %d", result);
+  }
+  // Dropping the batch on failure is fine; this is best-effort telemetry,
+  // and a batch kept past a failure would only be written beyond its end.
+  s_count = 0;
+}
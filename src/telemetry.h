@@ -0,0 +1,29 @@
+#pragma once
+
+#include <pebble.h>
+
+// Data logging tag for telemetry sessions; tools/telemetry_decode.py must match.
+#define TELEMETRY_TAG 0x71D3
+// Records held in RAM before they are handed to data logging in one go.
+#define TELEMETRY_BATCH_SIZE 16
+
+typedef enum {
+  TelemetryWeatherLatency = 1,  // value: ms from request to reply, aux: WeatherError
+  TelemetryBattery,             // value: charge percent, aux: 1 if charging
+  TelemetryRedraws,             // value: label renders since the last record
+  TelemetryFirstPaint,          // value: ms from main() to the first frame
+  TelemetryStorageWrites        // value: persist writes since the last record
+} TelemetryKind;
+
+// Fixed-size, little-endian record as it appears in the data logging session.
+typedef struct __attribute__((__packed__)) {
+  uint32_t timestamp;
+  uint16_t kind;
+  uint16_t aux;
+  int32_t value;
+} TelemetryRecord;
+
+void telemetry_init(void);
+void telemetry_deinit(void);
+void telemetry_record(TelemetryKind kind, int32_t value, uint16_t aux);
+void telemetry_flush(void);
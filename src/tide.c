@@ -0,0 +1,98 @@
+#include "tide.h"
+
+// Turning points are looked for a step at a time, then narrowed down.
+#define SEARCH_STEP (10 * 60)
+#define SEARCH_LIMIT (26 * 60 * 60)
+#define SEARCH_RESOLUTION 30
+
+static uint16_t read_u16(const uint8_t* data) {
+  return data[0] | (data[1] << 8);
+}
+
+static uint32_t read_u32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+// Number of station records following the header, or -1 if it isn't ours.
+int tide_station_count(const uint8_t* header, size_t length) {
+  if (length < TIDE_HEADER_SIZE || memcmp(header, "TIDE", 4) != 0 ||
+      header[4] != TIDE_VERSION || read_u16(&header[6]) != TIDE_RECORD_SIZE) {
+    return -1;
+  }
+  return header[5];
+}
+
+bool tide_station_decode(const uint8_t* record, size_t length, TideStation* station) {
+  if (length < TIDE_RECORD_SIZE || record[22] > TIDE_MAX_CONSTITUENTS) {
+    return false;
+  }
+  memcpy(station->name, record, TIDE_NAME_SIZE);
+  station->name[TIDE_NAME_SIZE - 1] = '\0';
+  station->epoch = read_u32(&record[16]);
+  station->datum_mm = (int16_t) read_u16(&record[20]);
+  station->count = record[22];
+  for (uint8_t i = 0; i < station->count; i++) {
+    const uint8_t* data = &record[24 + i * TIDE_CONSTITUENT_SIZE];
+    TideConstituent* constituent = &station->constituents[i];
+    constituent->rate = read_u32(data);
+    constituent->phase = read_u32(&data[4]);
+    constituent->amplitude_mm = read_u16(&data[8]);
+  }
+  return true;
+}
+
+static uint32_t angle_at(const TideConstituent* constituent, int32_t elapsed) {
+  return constituent->phase + (uint32_t) (((int64_t) constituent->rate * elapsed) >> TIDE_RATE_SHIFT);
+}
+
+int32_t tide_height_mm(const TideStation* station, time_t when) {
+  int32_t elapsed = when - (time_t) station->epoch;
+  int64_t sum = 0;
+  for (uint8_t i = 0; i < station->count; i++) {
+    const TideConstituent* constituent = &station->constituents[i];
+    sum += (int64_t) constituent->amplitude_mm * cos_lookup(angle_at(constituent, elapsed) >> 16);
+  }
+  return station->datum_mm + (int32_t) (sum / TRIG_MAX_RATIO);
+}
+
+// Proportional to the rate of change of height; only the sign matters.
+static int64_t slope(const TideStation* station, time_t when) {
+  int32_t elapsed = when - (time_t) station->epoch;
+  int64_t sum = 0;
+  for (uint8_t i = 0; i < station->count; i++) {
+    const TideConstituent* constituent = &station->constituents[i];
+    int64_t speed = (int64_t) constituent->amplitude_mm * (constituent->rate >> TIDE_RATE_SHIFT);
+    sum -= speed * sin_lookup(angle_at(constituent, elapsed) >> 16);
+  }
+  return sum;
+}
+
+// The first high or low water after "from", within a day or so.
+bool tide_next_event(const TideStation* station, time_t from, TideEvent* event) {
+  if (station->count == 0) {
+    return false;
+  }
+  int64_t before = slope(station, from);
+  for (time_t t = from + SEARCH_STEP; t <= from + SEARCH_LIMIT; t += SEARCH_STEP) {
+    int64_t after = slope(station, t);
+    if ((before > 0 && after <= 0) || (before < 0 && after >= 0)) {
+      bool high = before > 0;
+      time_t lo = t - SEARCH_STEP;
+      time_t hi = t;
+      while (hi - lo > SEARCH_RESOLUTION) {
+        time_t mid = lo + (hi - lo) / 2;
+        if ((slope(station, mid) > 0) == high) {
+          lo = mid;
+        } else {
+          hi = mid;
+        }
+      }
+      event->time = lo + (hi - lo) / 2;
+      event->height_mm = tide_height_mm(station, event->time);
+      event->high = high;
+      return true;
+    }
+    before = after;
+  }
+  return false;
+}
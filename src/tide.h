@@ -0,0 +1,48 @@
+#pragma once
+
+#include <pebble.h>
+
+// Harmonic tide prediction in integer arithmetic, from the constituent sets
+// in the TIDE_STATIONS resource built by tools/tide_stations.py.
+//
+// Each constituent contributes amplitude * cos(phase + rate * (t - epoch)).
+// Angles are binary: a full turn is 2^32, so they wrap for free. The rate is
+// in turns / 2^32 per second, scaled up by 2^TIDE_RATE_SHIFT to keep the
+// slow constituents accurate over a few years.
+#define TIDE_RATE_SHIFT 12
+#define TIDE_MAX_CONSTITUENTS 16
+#define TIDE_NAME_SIZE 16
+
+// Resource layout, little-endian:
+//   header: "TIDE", version (1), station count (1), record size (2)
+//   record: name (16), epoch (4), datum mm (2, signed), count (1), pad (1),
+//           then TIDE_MAX_CONSTITUENTS of rate (4), phase (4), amplitude mm (2), pad (2)
+#define TIDE_HEADER_SIZE 8
+#define TIDE_VERSION 1
+#define TIDE_CONSTITUENT_SIZE 12
+#define TIDE_RECORD_SIZE (24 + TIDE_MAX_CONSTITUENTS * TIDE_CONSTITUENT_SIZE)
+
+typedef struct {
+  uint32_t rate;
+  uint32_t phase;  // at the epoch
+  uint16_t amplitude_mm;
+} TideConstituent;
+
+typedef struct {
+  char name[TIDE_NAME_SIZE];
+  uint32_t epoch;
+  int16_t datum_mm;  // mean level above chart datum
+  uint8_t count;
+  TideConstituent constituents[TIDE_MAX_CONSTITUENTS];
+} TideStation;
+
+typedef struct {
+  time_t time;
+  int16_t height_mm;
+  bool high;
+} TideEvent;
+
+int tide_station_count(const uint8_t* header, size_t length);
+bool tide_station_decode(const uint8_t* record, size_t length, TideStation* station);
+int32_t tide_height_mm(const TideStation* station, time_t when);
+bool tide_next_event(const TideStation* station, time_t from, TideEvent* event);
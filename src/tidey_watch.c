@@ -1,14 +1,37 @@
 #include "pebble.h"
 #include "num2words.h"
+#include "time_service.h"
+#include "power_policy.h"
+#include "face_layer.h"
+#include "worker_link.h"
+#include "telemetry.h"
+#include "weather_state.h"
+#include "transfer_link.h"
+#include "forecast.h"
+#include "tide.h"
+#include "sun.h"
+#include "rain_alert.h"
+#include "storage.h"
 #include "secret.h"
 
 #define BUFFER_SIZE 86
 
+// Draw the whole face from one custom Layer rather than three TextLayers.
+// #define USE_FACE_LAYER
+
 static struct CommonWordsData {
   Window *window;
+  GFont phrase_font;
+#ifdef USE_FACE_LAYER
+  FaceLayer *face;
+#else
   TextLayer *time_label;
   TextLayer *date_label;
   TextLayer *weather_label;
+  // Empty layers either side of the labels, to time their redraw.
+  Layer *draw_begin;
+  Layer *draw_end;
+#endif
   char time_buffer[BUFFER_SIZE];
   char date_buffer[BUFFER_SIZE];
   char weather_description[BUFFER_SIZE];
@@ -19,26 +42,119 @@ static struct CommonWordsData {
   char weather_buffer[BUFFER_SIZE];
 } s_data;
 
-static bool force_update = false;
+// Keys we send to the phone. KEY_RESEND_TRANSFER and KEY_RESEND_CHUNK
+// (3 and 4) belong to transfer_link.
+enum {
+  KEY_API_KEY = 1,
+  KEY_RESYNC,
+  KEY_REQUEST = 5
+};
+
+// Sent under KEY_REQUEST once the phone has the key.
+enum {
+  REQUEST_WEATHER = 1
+};
 
+// The API key only goes over the link in the first request of a session;
+// any reply shows the phone has it.
+static bool s_key_delivered = false;
+// A phone that says it has no key is sent it again straight away at most
+// this often; otherwise it goes with the next poll.
+#define HANDSHAKE_MIN_INTERVAL (10 * 60)
+static time_t s_last_handshake = 0;
+
+// Sequence number of the last update from the phone, and whether we need a
+// full update because we don't know it or one went missing.
+static uint32_t s_last_sequence = 0;
+static bool s_need_resync = true;
+
+// Live readings fresher than this are shown in preference to the forecast.
+#define LIVE_WEATHER_MAX_AGE (30 * 60)
+// With this many hours of forecast in hand we only poll a few times a day.
+#define FORECAST_COMFORT_HOURS 3
+
+static Forecast s_forecast;
+
+// Which record of the TIDE_STATIONS resource to predict for.
+#define TIDE_STATION_INDEX 0
+
+static TideStation s_tide_station;
+static bool s_have_tide_station = false;
+// The next high or low water, worked out on the hour or once it has passed.
+static TideEvent s_next_tide;
+static bool s_have_next_tide = false;
+
+// Sunrise and sunset, worked out once a day where the phone last was.
+static SunCache s_sun;
+// The sunrise or sunset on the weather line, so we know when it has passed.
+static time_t s_sun_shown = 0;
+
+// Set once the phone has been asked for weather since launch.
+static bool s_weather_requested = false;
+// A request that found the outbox busy, to go once the outbox is free.
+static bool s_weather_pending = false;
+// When the outstanding weather request went out, 0 if none is outstanding.
+static uint32_t s_request_sent_ms = 0;
+// Label renders since the last telemetry record.
+static uint16_t s_render_count = 0;
+
+// Only the time and date are drawn before the first frame; everything else
+// waits for finish_startup(), run from a timer once that frame is out.
+static uint32_t s_main_ms = 0;
+static uint32_t s_first_paint_ms = 0;
+static Layer *s_first_paint_probe = NULL;
+static AppTimer *s_startup_timer = NULL;
+static bool s_started = false;
+
+
+// Labels that need redrawing but haven't been, because we're out of focus.
 enum {
-  KEY_TEMPERATURE = 0,
-  KEY_HOUR_FROM,
-  KEY_HOUR_SUMMARY,
-  KEY_WIND_SPEED,
-  KEY_WIND_BEARING
+  DIRTY_TIME = 1 << 0,
+  DIRTY_DATE = 1 << 1,
+  DIRTY_WEATHER = 1 << 2
 };
 
+static bool s_in_focus = true;
+static uint8_t s_dirty = 0;
+
+static void set_label_text(FaceRegion region, const char *text) {
+#ifdef USE_FACE_LAYER
+  face_layer_set_text(s_data.face, region, text);
+#else
+  switch(region) {
+    case FaceRegionWeather:
+      text_layer_set_text(s_data.weather_label, text);
+      break;
+    case FaceRegionTime:
+      text_layer_set_text(s_data.time_label, text);
+      break;
+    default:
+      text_layer_set_text(s_data.date_label, text);
+      break;
+  }
+#endif
+}
+
 void build_weather_label(void) {
   memset(s_data.weather_buffer, 0, BUFFER_SIZE);
-  snprintf(s_data.weather_buffer, BUFFER_SIZE, "%s %s %s %s %d°",
+  int len = snprintf(s_data.weather_buffer, BUFFER_SIZE, "%s %s %s %s %d°",
             s_data.weather_temperature,
             s_data.weather_timestamp,
             s_data.weather_description,
             s_data.weather_wind_speed,
             s_data.weather_wind_bearing
           );
-  text_layer_set_text(s_data.weather_label, (char*) &s_data.weather_buffer);
+
+  time_t when;
+  bool sunrise;
+  s_sun_shown = 0;
+  if (sun_cache_next_event(&s_sun, time(NULL), &when, &sunrise) && len >= 0 && len < BUFFER_SIZE) {
+    char hhmm[TIME_SERVICE_HHMM_LENGTH];
+    time_service_format_hhmm(when, hhmm);
+    snprintf(&s_data.weather_buffer[len], BUFFER_SIZE - len, " %s %s", sunrise ? "rise" : "set", hhmm);
+    s_sun_shown = when;
+  }
+  set_label_text(FaceRegionWeather, s_data.weather_buffer);
 }
 
 size_t printed_length ( int x )
@@ -46,69 +162,42 @@ size_t printed_length ( int x )
   return snprintf(NULL, 0, "%d", x);
 }
 
-void process_tuple(Tuple *t)
+// Called by weather_state only for keys whose value actually changed.
+static void handle_weather_changed(WeatherKey key, const WeatherSnapshot *state)
 {
-  // Get key
-  int key = t->key;
-
-  // Get integer value, if present
-  int value = t->value->int32;
-
-  // Get string value, if present
-  char string_value[BUFFER_SIZE];
-  strcpy(string_value, t->value->cstring);
-
   // Decide what to do
   switch(key) {
     case KEY_TEMPERATURE:
       memset(s_data.weather_temperature, 0, BUFFER_SIZE);
 
-      snprintf(s_data.weather_temperature, printed_length(value) + sizeof(" \u00B0C"), "%d \u00B0C", value);
+      snprintf(s_data.weather_temperature, printed_length(state->temperature) + sizeof(" \u00B0C"), "%d \u00B0C", state->temperature);
       break;
     case KEY_HOUR_FROM:
-      memset(s_data.weather_timestamp, 0, BUFFER_SIZE);
-      time_t sec = (time_t) value;
-      struct tm *tm;
-      tm = localtime (&sec);
-      strftime(s_data.weather_timestamp, BUFFER_SIZE, "%H:%M", tm);
+      time_service_format_hhmm((time_t) state->hour_from, s_data.weather_timestamp);
       break;
     case KEY_HOUR_SUMMARY:
       memset(s_data.weather_description, 0, BUFFER_SIZE);
-      strcpy(s_data.weather_description, string_value);
+      strncpy(s_data.weather_description, state->summary, BUFFER_SIZE - 1);
       break;
     case KEY_WIND_SPEED:
       memset(s_data.weather_wind_speed, 0, BUFFER_SIZE);
-      strcpy(s_data.weather_wind_speed, string_value);
+      strncpy(s_data.weather_wind_speed, state->wind_speed, BUFFER_SIZE - 1);
       break;
     case KEY_WIND_BEARING:
-      s_data.weather_wind_bearing = value;
+      s_data.weather_wind_bearing = state->wind_bearing;
+      break;
+    default:
       break;
   }
+  s_dirty |= DIRTY_WEATHER;
 }
 
-static void in_received_handler(DictionaryIterator *iter, void *context)
-{
-  // Get data
-  Tuple *t = dict_read_first(iter);
-  if (t) {
-    process_tuple(t);
-  }
-  // Get next
-  while(t != NULL) {
-    t = dict_read_next(iter);
-    if (t) {
-      process_tuple(t);
-    }
-  }
-  build_weather_label();
-}
-
-static TextLayer* init_text_layer(GRect location, GColor colour, GColor background, const char *res_id, GTextAlignment alignment)
+static TextLayer* init_text_layer(GRect location, GColor colour, GColor background, GFont font, GTextAlignment alignment)
 {
   TextLayer *layer = text_layer_create(location);
   text_layer_set_text_color(layer, colour);
   text_layer_set_background_color(layer, background);
-  text_layer_set_font(layer, fonts_get_system_font(res_id));
+  text_layer_set_font(layer, font);
   text_layer_set_text_alignment(layer, alignment);
 
   return layer;
@@ -117,36 +206,342 @@ static TextLayer* init_text_layer(GRect location, GColor colour, GColor backgrou
 static void update_time(struct tm* t) {
   fuzzy_time_to_words(t->tm_hour, t->tm_min, s_data.time_buffer, BUFFER_SIZE);
   // strcpy(s_data.time_buffer, "just gone quarter to midnight");
-  text_layer_set_text(s_data.time_label, s_data.time_buffer);
+  set_label_text(FaceRegionTime, s_data.time_buffer);
 }
 
 static void update_date(struct tm* t) {
-  clock_copy_time_string(s_data.date_buffer, BUFFER_SIZE);
-  int len = strlen(s_data.date_buffer);
-  strftime(&s_data.date_buffer[len], BUFFER_SIZE - len, " %a %e %b", t);
-  text_layer_set_text(s_data.date_label, s_data.date_buffer);
+  // The month makes way for the next tide.
+  const char *date_format = s_have_next_tide ? "%a %e" : "%a %e %b";
+  int len = 0;
+  if (power_policy_allows_optional_redraws()) {
+    clock_copy_time_string(s_data.date_buffer, BUFFER_SIZE);
+    len = strlen(s_data.date_buffer);
+    s_data.date_buffer[len++] = ' ';
+  }
+  // Without per-minute redraws the digital time would go stale, so it's dropped.
+  len += strftime(&s_data.date_buffer[len], BUFFER_SIZE - len, date_format, t);
+  if (s_have_next_tide && len + 3 + TIME_SERVICE_HHMM_LENGTH <= BUFFER_SIZE) {
+    s_data.date_buffer[len++] = ' ';
+    s_data.date_buffer[len++] = s_next_tide.high ? 'H' : 'L';
+    s_data.date_buffer[len++] = ' ';
+    time_service_format_hhmm(s_next_tide.time, &s_data.date_buffer[len]);
+  }
+  set_label_text(FaceRegionDate, s_data.date_buffer);
+}
+
+static bool load_tide_station(void) {
+  ResHandle handle = resource_get_handle(RESOURCE_ID_TIDE_STATIONS);
+  uint8_t header[TIDE_HEADER_SIZE];
+  if (resource_load_byte_range(handle, 0, header, sizeof(header)) != sizeof(header) ||
+      tide_station_count(header, sizeof(header)) <= TIDE_STATION_INDEX) {
+    return false;
+  }
+  uint8_t record[TIDE_RECORD_SIZE];
+  size_t offset = TIDE_HEADER_SIZE + TIDE_STATION_INDEX * TIDE_RECORD_SIZE;
+  return resource_load_byte_range(handle, offset, record, sizeof(record)) == sizeof(record) &&
+         tide_station_decode(record, sizeof(record), &s_tide_station);
+}
+
+static void update_sun(void) {
+  if (sun_cache_update(&s_sun, time_service_local_day(time(NULL)))) {
+    sun_cache_save(&s_sun);
+    s_dirty |= DIRTY_WEATHER;
+  }
 }
 
+// Tides come from the watch alone, so they carry on without the phone.
+static void update_tides(void) {
+  if (!s_have_tide_station) {
+    return;
+  }
+  TideEvent next;
+  bool have_next = tide_next_event(&s_tide_station, time(NULL), &next);
+  if (have_next != s_have_next_tide || (have_next && next.time != s_next_tide.time)) {
+    s_dirty |= DIRTY_DATE;
+  }
+  s_next_tide = next;
+  s_have_next_tide = have_next;
+}
+
+// Bring every dirty label up to date in one pass. Does nothing while a
+// notification or other modal covers the face.
+static void render_dirty(struct tm* t) {
+  if (!s_in_focus || s_dirty == 0) {
+    return;
+  }
+  if ((s_dirty & (DIRTY_TIME | DIRTY_DATE)) && t == NULL) {
+    time_t now = time(NULL);
+    t = localtime(&now);
+  }
+  if (s_dirty & DIRTY_TIME) {
+    update_time(t);
+  }
+  if (s_dirty & DIRTY_DATE) {
+    update_date(t);
+  }
+  if (s_dirty & DIRTY_WEATHER) {
+    build_weather_label();
+  }
+  s_dirty = 0;
+  s_render_count++;
+}
+
+static void handle_focus(bool in_focus) {
+  s_in_focus = in_focus;
+  if (in_focus) {
+#ifdef USE_FACE_LAYER
+    // Whatever covered us has scribbled over the framebuffer.
+    face_layer_mark_all_dirty(s_data.face);
+#endif
+    render_dirty(NULL);
+  }
+}
+
+// The outbox is shared with transfer_link, so it may be busy; if so the
+// request is held and sent from the outbox handlers once it frees up.
 void update_weather_on_phone(void)
 {
   DictionaryIterator *iter;
-  app_message_outbox_begin(&iter);
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    s_weather_pending = true;
+    return;
+  }
 
   // change this to hosted solution if making .pbw public.
-  dict_write_cstring(iter, 1, (char *) API_KEY);
+  if (s_key_delivered) {
+    dict_write_uint8(iter, KEY_REQUEST, REQUEST_WEATHER);
+  } else {
+    dict_write_cstring(iter, KEY_API_KEY, (char *) API_KEY);
+    s_last_handshake = time(NULL);
+  }
+  if (s_need_resync) {
+    dict_write_uint8(iter, KEY_RESYNC, 1);
+  }
   dict_write_end(iter);
 
-  app_message_outbox_send();
+  if (app_message_outbox_send() != APP_MSG_OK) {
+    s_weather_pending = true;
+    return;
+  }
+  s_weather_pending = false;
+  s_weather_requested = true;
+  s_request_sent_ms = time_service_now_ms();
+}
+
+static void out_sent_handler(DictionaryIterator *sent, void *context) {
+  if (s_weather_pending) {
+    update_weather_on_phone();
+  }
+}
+
+// A failed weather request waits for the next poll rather than retrying
+// into a link that is down; only one held back for a busy outbox goes now.
+static void out_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context) {
+  if (dict_find(failed, KEY_REQUEST) || dict_find(failed, KEY_API_KEY)) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "weather request not delivered: %d", reason);
+    s_request_sent_ms = 0;
+  }
+  if (s_weather_pending) {
+    update_weather_on_phone();
+  }
+}
+
+// Once the live reading has gone stale, show the forecast for this hour.
+static void show_forecast_hour(void) {
+  time_t now = time(NULL);
+  const WeatherSnapshot *live = weather_state_get();
+  if (live->fetched_at && now - (time_t) live->fetched_at < LIVE_WEATHER_MAX_AGE) {
+    return;
+  }
+  time_t hour_start;
+  const ForecastHour *hour = forecast_hour_at(&s_forecast, now, &hour_start);
+  if (!hour) {
+    return;
+  }
+
+  // Only the displayed fields change; fetched_at still says how old the live data is.
+  WeatherSnapshot snapshot = *live;
+  snapshot.temperature = hour->temperature;
+  snapshot.hour_from = hour_start;
+  snapshot.wind_bearing = hour->wind_bearing_half * 2;
+  snprintf(snapshot.wind_speed, sizeof(snapshot.wind_speed), "%d", hour->wind_speed);
+  memset(snapshot.summary, 0, sizeof(snapshot.summary));
+  strncpy(snapshot.summary, hour->summary, sizeof(snapshot.summary) - 1);
+  if (weather_state_apply_snapshot(&snapshot)) {
+    // The phone's deltas are against the live values we just replaced.
+    s_need_resync = true;
+  }
+  render_dirty(NULL);
+}
+
+static void handle_transfer_complete(const uint8_t *data, uint16_t length) {
+  switch (data[0]) {
+    case TRANSFER_KIND_HOURLY:
+      if (!forecast_decode(data, length, &s_forecast)) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "bad hourly forecast transfer");
+        forecast_load(&s_forecast);
+        return;
+      }
+      forecast_save(&s_forecast);
+      APP_LOG(APP_LOG_LEVEL_DEBUG, "stored %d hour forecast", s_forecast.count);
+      break;
+    default:
+      APP_LOG(APP_LOG_LEVEL_WARNING, "unknown %d byte transfer", length);
+      break;
+  }
+}
+
+static void in_dropped_handler(AppMessageResult reason, void *context) {
+  APP_LOG(APP_LOG_LEVEL_WARNING, "inbox dropped message: %d", reason);
+  transfer_link_message_dropped();
+}
+
+static void in_received_handler(DictionaryIterator *iter, void *context)
+{
+  if (transfer_link_handle_message(iter)) {
+    return;
+  }
+
+  Tuple *error = dict_find(iter, KEY_WEATHER_ERROR);
+  WeatherError error_code = error ? (WeatherError) error->value->int32 : WeatherErrorNone;
+  if (s_request_sent_ms) {
+    telemetry_record(TelemetryWeatherLatency, time_service_now_ms() - s_request_sent_ms, error_code);
+    s_request_sent_ms = 0;
+  }
+  if (error_code == WeatherErrorNoKey) {
+    // Shake hands again, unless it was the handshake that was turned down or
+    // we did so only a moment ago; the next poll will carry the key anyway.
+    bool was_delivered = s_key_delivered;
+    s_key_delivered = false;
+    if (was_delivered && time(NULL) - s_last_handshake >= HANDSHAKE_MIN_INTERVAL) {
+      update_weather_on_phone();
+    }
+    return;
+  }
+  s_key_delivered = true;
+  if (error) {
+    // Keep showing what we had; the next poll will try again.
+    APP_LOG(APP_LOG_LEVEL_WARNING, "phone couldn't get weather: %d", error_code);
+    return;
+  }
+
+  bool gap = false;
+  Tuple *sequence = dict_find(iter, KEY_SEQUENCE);
+  if (sequence) {
+    if (dict_find(iter, KEY_FULL_UPDATE)) {
+      s_need_resync = false;
+    } else if (sequence->value->uint32 != s_last_sequence + 1) {
+      gap = !s_need_resync;
+      s_need_resync = true;
+    }
+    s_last_sequence = sequence->value->uint32;
+  }
+
+  Tuple *latitude = dict_find(iter, KEY_LATITUDE);
+  Tuple *longitude = dict_find(iter, KEY_LONGITUDE);
+  if (latitude || longitude) {
+    // A delta may carry only the one that changed.
+    int32_t latitude_e4 = latitude ? latitude->value->int32 : s_sun.latitude_e4;
+    int32_t longitude_e4 = longitude ? longitude->value->int32 : s_sun.longitude_e4;
+    if (sun_cache_set_location(&s_sun, latitude_e4, longitude_e4)) {
+      update_sun();
+    }
+  }
+
+  Tuple *precipitation = dict_find(iter, KEY_PRECIPITATION);
+  if (precipitation && precipitation->type == TUPLE_BYTE_ARRAY) {
+    rain_alert_update(precipitation->value->data, precipitation->length);
+  }
+
+  // Deltas hold absolute values, so even one after a gap is safe to merge.
+  bool changed = false;
+  // Get data
+  Tuple *t = dict_read_first(iter);
+  while(t != NULL) {
+    changed |= weather_state_apply_tuple(t);
+    // Get next
+    t = dict_read_next(iter);
+  }
+  // Several messages arriving while out of focus collapse into one rebuild.
+  render_dirty(NULL);
+
+  weather_state_touch(time(NULL));
+  if (changed) {
+    worker_link_publish(weather_state_get());
+  } else {
+    worker_link_touch(weather_state_get()->fetched_at);
+  }
+
+  if (gap) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "missed weather update before %d, resyncing", (int) s_last_sequence);
+    update_weather_on_phone();
+  }
 }
 
 static bool every_ten_minutes(struct tm* t) {
   return t->tm_min % 10 == 0;
 }
 
+static bool forecast_running_low(void) {
+  return forecast_hours_left(&s_forecast, time(NULL)) < FORECAST_COMFORT_HOURS;
+}
+
+// Every ten minutes until we have a few hours of forecast and the rain
+// series has a while to run, then every six hours.
+static bool weather_poll_due(struct tm* t) {
+  if (!every_ten_minutes(t)) {
+    return false;
+  }
+  return forecast_running_low() || rain_alert_running_low(time(NULL)) || (t->tm_min == 0 && t->tm_hour % 6 == 0);
+}
+
 static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
-  update_time(tick_time);
-  update_date(tick_time);
-  if (force_update || every_ten_minutes(tick_time)) {
+  if (units_changed & HOUR_UNIT) {
+    time_service_update_offset(tick_time);
+    telemetry_record(TelemetryRedraws, s_render_count, 0);
+    s_render_count = 0;
+  }
+  if (power_policy_should_update_time(tick_time, units_changed)) {
+    s_dirty |= DIRTY_TIME;
+  }
+  if (power_policy_allows_optional_redraws() || (units_changed & DAY_UNIT)) {
+    s_dirty |= DIRTY_DATE;
+  }
+  if ((units_changed & HOUR_UNIT) || (s_have_next_tide && time(NULL) >= s_next_tide.time)) {
+    update_tides();
+  }
+  if (units_changed & DAY_UNIT) {
+    update_sun();
+    telemetry_record(TelemetryStorageWrites, storage_take_write_count(), 0);
+  }
+  if (s_sun_shown && time(NULL) >= s_sun_shown) {
+    s_dirty |= DIRTY_WEATHER;
+  }
+  render_dirty(tick_time);
+  if ((units_changed & HOUR_UNIT) || every_ten_minutes(tick_time)) {
+    show_forecast_hour();
+  }
+  if (power_policy_allows_weather() && weather_poll_due(tick_time)) {
+    update_weather_on_phone();
+  }
+  // Whatever the last minute's messages changed goes to flash in one go.
+  storage_flush(time(NULL));
+}
+
+static void handle_rain_onset(time_t onset) {
+  char hhmm[TIME_SERVICE_HHMM_LENGTH];
+  time_service_format_hhmm(onset, hhmm);
+  APP_LOG(APP_LOG_LEVEL_INFO, "rain starting at %s", hhmm);
+  if (power_policy_mode() != PowerModeCritical) {
+    vibes_double_pulse();
+  }
+}
+
+static void handle_power_mode_changed(PowerMode old_mode, PowerMode new_mode) {
+  s_dirty |= DIRTY_TIME | DIRTY_DATE;
+  render_dirty(NULL);
+  if (new_mode == PowerModeNormal) {
+    // Weather may be well out of date after a stretch without polling.
     update_weather_on_phone();
   }
 }
@@ -169,55 +564,197 @@ void compass_callback(CompassHeadingData heading) {
   }
 }
 
+static void handle_worker_snapshot(const WeatherSnapshot *snapshot) {
+  if (snapshot && snapshot->fetched_at >= weather_state_get()->fetched_at) {
+    weather_state_apply_snapshot(snapshot);
+    render_dirty(NULL);
+  }
+
+  uint32_t fetched_at = weather_state_get()->fetched_at;
+  bool stale = fetched_at == 0 || time(NULL) - (time_t) fetched_at >= WORKER_SNAPSHOT_MAX_AGE;
+  if (stale && forecast_running_low() && !s_weather_requested && power_policy_allows_weather()) {
+    update_weather_on_phone();
+  }
+}
+
+#ifdef USE_FACE_LAYER
+static void handle_window_appear(Window *window) {
+  face_layer_mark_all_dirty(s_data.face);
+}
+#else
+// Children draw in order, so the three labels draw between these two; the
+// slowest redraw is logged the same way the face layer logs its own.
+static uint32_t s_draw_started_ms = 0;
+static uint16_t s_worst_draw_ms = 0;
+
+static void draw_begin_update_proc(Layer *layer, GContext *ctx) {
+  s_draw_started_ms = time_service_now_ms();
+}
+
+static void draw_end_update_proc(Layer *layer, GContext *ctx) {
+  uint16_t elapsed = time_service_now_ms() - s_draw_started_ms;
+  if (elapsed > s_worst_draw_ms) {
+    s_worst_draw_ms = elapsed;
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "text layers draw %d ms", elapsed);
+  }
+}
+#endif
+
+static void finish_startup(void *context) {
+  s_startup_timer = NULL;
+  layer_remove_from_parent(s_first_paint_probe);
+  layer_destroy(s_first_paint_probe);
+  s_first_paint_probe = NULL;
+
+  //Register AppMessage events
+  app_message_register_inbox_received(in_received_handler);
+  app_message_register_inbox_dropped(in_dropped_handler);
+  app_message_register_outbox_sent(out_sent_handler);
+  app_message_register_outbox_failed(out_failed_handler);
+  transfer_link_init(handle_transfer_complete);
+  app_message_open(app_message_inbox_size_maximum(), app_message_outbox_size_maximum());
+
+  time_t now = time(NULL);
+  struct tm *t = localtime(&now);
+  telemetry_init();
+  storage_init();
+  telemetry_record(TelemetryFirstPaint, s_first_paint_ms, 0);
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "first frame %d ms after launch", (int) s_first_paint_ms);
+  forecast_load(&s_forecast);
+  sun_cache_load(&s_sun);
+  rain_alert_init(handle_rain_onset);
+  s_have_tide_station = load_tide_station();
+  if (s_have_tide_station) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "predicting tides for %s", s_tide_station.name);
+  }
+  weather_state_init(handle_weather_changed);
+  power_policy_init(handle_power_mode_changed);
+  // Treat startup as every unit having changed so each label gets drawn.
+  handle_minute_tick(t, MINUTE_UNIT | HOUR_UNIT | DAY_UNIT);
+  // Unless the tick above already asked the phone, the age of the worker's
+  // snapshot decides whether we need fresh weather.
+  worker_link_init(handle_worker_snapshot);
+
+  app_focus_service_subscribe(handle_focus);
+  // compass_service_set_heading_filter(90);
+  // compass_service_subscribe(&compass_callback);
+  tick_timer_service_subscribe(MINUTE_UNIT, &handle_minute_tick);
+  s_started = true;
+}
+
+// Draws nothing; the first time it is asked to, the first frame is going out.
+static void first_paint_update_proc(Layer *layer, GContext *ctx) {
+  if (s_started || s_startup_timer) {
+    return;
+  }
+  s_first_paint_ms = time_service_now_ms() - s_main_ms;
+  s_startup_timer = app_timer_register(0, finish_startup, NULL);
+}
+
 static void do_init(void) {
   s_data.window = window_create();
   const bool animated = true;
   window_stack_push(s_data.window, animated);
 
-  window_set_background_color(s_data.window, GColorBlack);
-
   Layer *root_layer = window_get_root_layer(s_data.window);
   GRect frame = layer_get_frame(root_layer);
 
   int top_y = 36;
   int bottom_y = 20;
 
-  s_data.weather_label = init_text_layer(GRect(0, -5, frame.size.w, top_y), COLOR_FALLBACK(GColorMalachite, GColorWhite), GColorBlack, "RESOURCE_ID_GOTHIC_18_BOLD", GTextAlignmentCenter);
+  // The time and date boxes share two rows so the phrase keeps its last line
+  // and the date its descenders; face_layer repaints them together.
+  GRect weather_box = GRect(0, -5, frame.size.w, top_y);
+  GRect time_box = GRect(0, top_y - 5, frame.size.w, frame.size.h - bottom_y - top_y + 9);
+  GRect date_box = GRect(0, frame.size.h - bottom_y + 2, frame.size.w, bottom_y + 1);
+  GColor text_colour = COLOR_FALLBACK(GColorMalachite, GColorWhite);
+  GFont small_font = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
+  // Only holds the glyphs the phrase tables use; see check_phrase_glyphs in wscript.
+  s_data.phrase_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_PHRASE_28));
+
+#ifndef USE_FACE_LAYER
+  // Made before the heap is measured, so only the labels are counted.
+  s_data.draw_begin = layer_create(frame);
+  layer_set_update_proc(s_data.draw_begin, draw_begin_update_proc);
+  s_data.draw_end = layer_create(frame);
+  layer_set_update_proc(s_data.draw_end, draw_end_update_proc);
+#endif
+
+  size_t heap_before = heap_bytes_used();
+#ifdef USE_FACE_LAYER
+  // The face layer paints its own background, only where text changed.
+  window_set_background_color(s_data.window, GColorClear);
+  window_set_window_handlers(s_data.window, (WindowHandlers) {
+    .appear = handle_window_appear
+  });
+
+  s_data.face = face_layer_create(frame, text_colour, GColorBlack);
+  face_layer_set_region(s_data.face, FaceRegionWeather, weather_box, small_font, GTextAlignmentCenter);
+  face_layer_set_region(s_data.face, FaceRegionTime, time_box, s_data.phrase_font, GTextAlignmentLeft);
+  face_layer_set_region(s_data.face, FaceRegionDate, date_box, small_font, GTextAlignmentCenter);
+  layer_add_child(root_layer, face_layer_get_layer(s_data.face));
+#else
+  window_set_background_color(s_data.window, GColorBlack);
+  layer_add_child(root_layer, s_data.draw_begin);
+
+  s_data.weather_label = init_text_layer(weather_box, text_colour, GColorBlack, small_font, GTextAlignmentCenter);
   layer_add_child(root_layer, text_layer_get_layer(s_data.weather_label));
 
-  s_data.time_label = init_text_layer(GRect(0, top_y - 5, frame.size.w, frame.size.h - bottom_y - top_y + 9), COLOR_FALLBACK(GColorMalachite, GColorWhite), GColorBlack, "RESOURCE_ID_BITHAM_30_BLACK", GTextAlignmentLeft);
+  s_data.time_label = init_text_layer(time_box, text_colour, GColorBlack, s_data.phrase_font, GTextAlignmentLeft);
   layer_add_child(root_layer, text_layer_get_layer(s_data.time_label));
 
-  s_data.date_label = init_text_layer(GRect(0, frame.size.h - bottom_y + 2, frame.size.w, bottom_y + 1), COLOR_FALLBACK(GColorMalachite, GColorWhite), GColorBlack, "RESOURCE_ID_GOTHIC_18_BOLD", GTextAlignmentCenter);
+  s_data.date_label = init_text_layer(date_box, text_colour, GColorBlack, small_font, GTextAlignmentCenter);
   layer_add_child(root_layer, text_layer_get_layer(s_data.date_label));
+  layer_add_child(root_layer, s_data.draw_end);
+#endif
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "layers use %d bytes of heap", (int) (heap_bytes_used() - heap_before));
 
-  //Register AppMessage events
-  app_message_register_inbox_received(in_received_handler);
-  app_message_open(app_message_inbox_size_maximum(), app_message_outbox_size_maximum());
+  s_first_paint_probe = layer_create(frame);
+  layer_set_update_proc(s_first_paint_probe, first_paint_update_proc);
+  layer_add_child(root_layer, s_first_paint_probe);
 
+  // Just the time and date for the first frame; tides, sun and weather
+  // follow from finish_startup() a moment later.
   time_t now = time(NULL);
   struct tm *t = localtime(&now);
-  if (!every_ten_minutes(t)) {
-    force_update = true;
-  }
-  handle_minute_tick(t, 0);
-  force_update = false;
-
-  // compass_service_set_heading_filter(90);
-  // compass_service_subscribe(&compass_callback);
-  tick_timer_service_subscribe(MINUTE_UNIT, &handle_minute_tick);
+  update_time(t);
+  update_date(t);
 }
 
 static void do_deinit(void) {
-  tick_timer_service_unsubscribe();
+  if (s_started) {
+    tick_timer_service_unsubscribe();
+    power_policy_deinit();
+    app_focus_service_unsubscribe();
+    worker_link_deinit();
+    transfer_link_deinit();
+    rain_alert_deinit();
+    weather_state_deinit();
+    storage_deinit();
+    telemetry_deinit();
+  } else {
+    // Closed before the first frame went out.
+    if (s_startup_timer) {
+      app_timer_cancel(s_startup_timer);
+    }
+    layer_destroy(s_first_paint_probe);
+  }
   // compass_service_unsubscribe();
   window_destroy(s_data.window);
+#ifdef USE_FACE_LAYER
+  face_layer_destroy(s_data.face);
+#else
   text_layer_destroy(s_data.date_label);
   text_layer_destroy(s_data.time_label);
   text_layer_destroy(s_data.weather_label);
+  layer_destroy(s_data.draw_end);
+  layer_destroy(s_data.draw_begin);
+#endif
+  fonts_unload_custom_font(s_data.phrase_font);
 }
 
 int main(void) {
+  s_main_ms = time_service_now_ms();
   do_init();
   app_event_loop();
   do_deinit();
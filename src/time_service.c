@@ -0,0 +1,80 @@
+#include "time_service.h"
+
+#ifndef SECONDS_PER_MINUTE
+#define SECONDS_PER_MINUTE 60
+#define SECONDS_PER_HOUR 3600
+#define SECONDS_PER_DAY 86400
+#endif
+
+// Real-world offsets are all whole quarter hours, so rounding to this
+// hides the second or so between the tick firing and time() being read.
+#define OFFSET_GRANULARITY (15 * SECONDS_PER_MINUTE)
+
+static const char TWO_DIGITS[60][3] = {
+  "00", "01", "02", "03", "04", "05", "06", "07", "08", "09",
+  "10", "11", "12", "13", "14", "15", "16", "17", "18", "19",
+  "20", "21", "22", "23", "24", "25", "26", "27", "28", "29",
+  "30", "31", "32", "33", "34", "35", "36", "37", "38", "39",
+  "40", "41", "42", "43", "44", "45", "46", "47", "48", "49",
+  "50", "51", "52", "53", "54", "55", "56", "57", "58", "59"
+};
+
+static int32_t s_utc_offset = 0;
+
+// Work the offset out from a struct tm we already have (the tick handler is
+// handed one) rather than calling localtime() again.
+void time_service_update_offset(const struct tm* local_time) {
+  int32_t local_seconds = local_time->tm_hour * SECONDS_PER_HOUR
+                        + local_time->tm_min * SECONDS_PER_MINUTE
+                        + local_time->tm_sec;
+  int32_t utc_seconds = (int32_t) (time(NULL) % SECONDS_PER_DAY);
+  int32_t offset = local_seconds - utc_seconds;
+
+  // Crossing midnight between the two clocks puts us a day out.
+  if (offset > SECONDS_PER_DAY / 2) {
+    offset -= SECONDS_PER_DAY;
+  } else if (offset < -SECONDS_PER_DAY / 2) {
+    offset += SECONDS_PER_DAY;
+  }
+
+  if (offset >= 0) {
+    offset = (offset + OFFSET_GRANULARITY / 2) / OFFSET_GRANULARITY * OFFSET_GRANULARITY;
+  } else {
+    offset = -((-offset + OFFSET_GRANULARITY / 2) / OFFSET_GRANULARITY * OFFSET_GRANULARITY);
+  }
+  s_utc_offset = offset;
+}
+
+int32_t time_service_utc_offset(void) {
+  return s_utc_offset;
+}
+
+// Days since the epoch by the local calendar.
+int32_t time_service_local_day(time_t epoch) {
+  int32_t local = (int32_t) (epoch + s_utc_offset);
+  return local / SECONDS_PER_DAY - (local % SECONDS_PER_DAY < 0);
+}
+
+// Wraps after ~49 days, which is fine for measuring short intervals.
+uint32_t time_service_now_ms(void) {
+  time_t seconds;
+  uint16_t millis;
+  time_ms(&seconds, &millis);
+  return (uint32_t) seconds * 1000 + millis;
+}
+
+void time_service_format_hhmm(time_t epoch, char* buffer) {
+  int32_t seconds_of_day = (int32_t) ((epoch + s_utc_offset) % SECONDS_PER_DAY);
+  if (seconds_of_day < 0) {
+    seconds_of_day += SECONDS_PER_DAY;
+  }
+  int hours = seconds_of_day / SECONDS_PER_HOUR;
+  int minutes = seconds_of_day / SECONDS_PER_MINUTE % 60;
+
+  buffer[0] = TWO_DIGITS[hours][0];
+  buffer[1] = TWO_DIGITS[hours][1];
+  buffer[2] = ':';
+  buffer[3] = TWO_DIGITS[minutes][0];
+  buffer[4] = TWO_DIGITS[minutes][1];
+  buffer[5] = '\0';
+}
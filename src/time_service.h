@@ -0,0 +1,12 @@
+#pragma once
+
+#include <pebble.h>
+
+// Buffer size needed for "HH:MM" plus terminator.
+#define TIME_SERVICE_HHMM_LENGTH 6
+
+void time_service_update_offset(const struct tm* local_time);
+int32_t time_service_utc_offset(void);
+void time_service_format_hhmm(time_t epoch, char* buffer);
+int32_t time_service_local_day(time_t epoch);
+uint32_t time_service_now_ms(void);
@@ -0,0 +1,60 @@
+#include "transfer.h"
+
+void transfer_reset(Transfer* transfer) {
+  transfer->id = 0;
+  transfer->total_length = 0;
+  transfer->chunk_count = 0;
+  transfer->received = 0;
+}
+
+static uint16_t chunk_length(const Transfer* transfer, uint16_t index) {
+  if (index + 1 < transfer->chunk_count) {
+    return TRANSFER_CHUNK_SIZE;
+  }
+  return transfer->total_length - index * TRANSFER_CHUNK_SIZE;
+}
+
+static bool is_complete(const Transfer* transfer) {
+  return transfer->received == (1u << transfer->chunk_count) - 1;
+}
+
+// A chunk with a new transfer id abandons whatever was being reassembled.
+// Chunks may arrive in any order and duplicates are harmless; resends that
+// trail in after the transfer completed are reported, not completed again.
+TransferResult transfer_receive_chunk(Transfer* transfer, uint16_t id, uint16_t index,
+                                      uint16_t total_length, const uint8_t* data, uint16_t length) {
+  if (total_length == 0 || total_length > TRANSFER_BUFFER_SIZE) {
+    return TransferRejected;
+  }
+  if (id == transfer->id && total_length == transfer->total_length && transfer->chunk_count > 0 &&
+      is_complete(transfer)) {
+    return TransferDuplicate;
+  }
+  if (id != transfer->id || total_length != transfer->total_length) {
+    transfer_reset(transfer);
+    transfer->id = id;
+    transfer->total_length = total_length;
+    transfer->chunk_count = (total_length + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE;
+  }
+  if (index >= transfer->chunk_count || length != chunk_length(transfer, index)) {
+    return TransferRejected;
+  }
+
+  memcpy(&transfer->buffer[index * TRANSFER_CHUNK_SIZE], data, length);
+  transfer->received |= 1u << index;
+  return is_complete(transfer) ? TransferComplete : TransferInProgress;
+}
+
+// Index of the first chunk still to come, or -1 if there are none.
+int transfer_next_missing(const Transfer* transfer) {
+  for (int i = 0; i < transfer->chunk_count; i++) {
+    if (!(transfer->received & (1u << i))) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool transfer_is_active(const Transfer* transfer) {
+  return transfer->chunk_count > 0 && !is_complete(transfer);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <pebble.h>
+
+// Payloads too big for one AppMessage arrive as numbered chunks of
+// TRANSFER_CHUNK_SIZE bytes (the last may be shorter), tagged with a transfer
+// id and the total length, and are reassembled here. Must match the JS.
+#define TRANSFER_CHUNK_SIZE 512
+#define TRANSFER_BUFFER_SIZE 4096
+#define TRANSFER_MAX_CHUNKS (TRANSFER_BUFFER_SIZE / TRANSFER_CHUNK_SIZE)
+
+typedef enum {
+  TransferInProgress,
+  TransferComplete,
+  TransferDuplicate,  // a chunk of the transfer that last completed
+  TransferRejected
+} TransferResult;
+
+typedef struct {
+  uint16_t id;
+  uint16_t total_length;
+  uint8_t chunk_count;
+  uint32_t received;  // bitmap of chunk indices
+  uint8_t buffer[TRANSFER_BUFFER_SIZE];
+} Transfer;
+
+void transfer_reset(Transfer* transfer);
+TransferResult transfer_receive_chunk(Transfer* transfer, uint16_t id, uint16_t index,
+                                      uint16_t total_length, const uint8_t* data, uint16_t length);
+int transfer_next_missing(const Transfer* transfer);
+bool transfer_is_active(const Transfer* transfer);
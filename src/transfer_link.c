@@ -0,0 +1,120 @@
+#include "transfer_link.h"
+#include "weather_state.h"
+
+#define DROPPED_RETRY_MS 250
+
+static Transfer s_transfer;
+static TransferCompleteHandler s_handler = NULL;
+static AppTimer* s_timer = NULL;
+static uint8_t s_retries = 0;
+// The chunk last asked for, so a gap is only asked about once per timeout
+// however many chunks arrive after it.
+static int s_requested = -1;
+
+static void request_missing_chunk(void) {
+  int missing = transfer_next_missing(&s_transfer);
+  DictionaryIterator* iter;
+  if (missing < 0 || app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return;
+  }
+  s_requested = missing;
+  dict_write_uint16(iter, KEY_RESEND_TRANSFER, s_transfer.id);
+  dict_write_uint8(iter, KEY_RESEND_CHUNK, missing);
+  dict_write_end(iter);
+  app_message_outbox_send();
+}
+
+static void handle_timeout(void* data);
+
+static void arm_timer(uint32_t timeout_ms) {
+  if (s_timer) {
+    app_timer_reschedule(s_timer, timeout_ms);
+  } else {
+    s_timer = app_timer_register(timeout_ms, handle_timeout, NULL);
+  }
+}
+
+static void cancel_timer(void) {
+  if (s_timer) {
+    app_timer_cancel(s_timer);
+    s_timer = NULL;
+  }
+}
+
+static void handle_timeout(void* data) {
+  s_timer = NULL;
+  if (!transfer_is_active(&s_transfer)) {
+    return;
+  }
+  if (s_retries++ >= TRANSFER_LINK_MAX_RETRIES) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "giving up on transfer %d", s_transfer.id);
+    transfer_reset(&s_transfer);
+    return;
+  }
+  request_missing_chunk();
+  arm_timer(TRANSFER_LINK_CHUNK_TIMEOUT_MS);
+}
+
+void transfer_link_init(TransferCompleteHandler handler) {
+  transfer_reset(&s_transfer);
+  s_handler = handler;
+}
+
+void transfer_link_deinit(void) {
+  cancel_timer();
+  s_handler = NULL;
+}
+
+// Returns false if the message isn't part of a transfer.
+bool transfer_link_handle_message(DictionaryIterator* iter) {
+  Tuple* id = dict_find(iter, KEY_TRANSFER_ID);
+  if (!id) {
+    return false;
+  }
+  Tuple* index = dict_find(iter, KEY_TRANSFER_CHUNK);
+  Tuple* length = dict_find(iter, KEY_TRANSFER_LENGTH);
+  Tuple* data = dict_find(iter, KEY_TRANSFER_DATA);
+  if (!index || !length || !data || data->type != TUPLE_BYTE_ARRAY) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "malformed transfer chunk");
+    return true;
+  }
+
+  if (id->value->uint16 != s_transfer.id) {
+    s_retries = 0;
+    s_requested = -1;
+  }
+  int expected = id->value->uint16 == s_transfer.id ? transfer_next_missing(&s_transfer) : 0;
+  TransferResult result = transfer_receive_chunk(&s_transfer, id->value->uint16, index->value->uint16,
+                                                 length->value->uint16, data->value->data, data->length);
+  switch (result) {
+    case TransferComplete:
+      cancel_timer();
+      if (s_handler) {
+        s_handler(s_transfer.buffer, s_transfer.total_length);
+      }
+      break;
+    case TransferInProgress:
+      // The phone sends chunks in order, so skipping ahead means one was lost.
+      // The timeout asks again if the resend doesn't come.
+      if (expected >= 0 && index->value->uint16 > expected && expected != s_requested) {
+        request_missing_chunk();
+      }
+      arm_timer(TRANSFER_LINK_CHUNK_TIMEOUT_MS);
+      break;
+    case TransferDuplicate:
+      // A resend we asked for before the gap filled itself; already handled.
+      break;
+    case TransferRejected:
+      APP_LOG(APP_LOG_LEVEL_WARNING, "rejected chunk %d of transfer %d", index->value->uint16, id->value->uint16);
+      break;
+  }
+  return true;
+}
+
+// We can't tell which message was dropped, so if a transfer is under way
+// check for a missing chunk sooner than we otherwise would.
+void transfer_link_message_dropped(void) {
+  if (transfer_is_active(&s_transfer)) {
+    arm_timer(DROPPED_RETRY_MS);
+  }
+}
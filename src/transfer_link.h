@@ -0,0 +1,20 @@
+#pragma once
+
+#include <pebble.h>
+#include "transfer.h"
+
+// Keys we send to the phone to ask for a chunk again.
+#define KEY_RESEND_TRANSFER 3
+#define KEY_RESEND_CHUNK 4
+
+// How long to wait for the next chunk before asking for it again, and how
+// many times to ask before giving up on the transfer.
+#define TRANSFER_LINK_CHUNK_TIMEOUT_MS 2000
+#define TRANSFER_LINK_MAX_RETRIES 3
+
+typedef void (*TransferCompleteHandler)(const uint8_t* data, uint16_t length);
+
+void transfer_link_init(TransferCompleteHandler handler);
+void transfer_link_deinit(void);
+bool transfer_link_handle_message(DictionaryIterator* iter);
+void transfer_link_message_dropped(void);
@@ -0,0 +1,152 @@
+#include "weather_state.h"
+#include <stddef.h>
+#include "summary_words.h"
+#include "storage.h"
+
+// A shadow copy of the weather dictionary, like AppSync keeps, but without
+// AppSync taking over the AppMessage callbacks. Each key maps onto a field
+// of the snapshot so updates can be compared in place.
+typedef struct {
+  uint16_t offset;
+  uint16_t size;
+  TupleType type;
+} Field;
+
+static const Field FIELDS[WEATHER_KEY_COUNT] = {
+  [KEY_TEMPERATURE] = { offsetof(WeatherSnapshot, temperature), sizeof(int16_t), TUPLE_INT },
+  [KEY_HOUR_FROM] = { offsetof(WeatherSnapshot, hour_from), sizeof(int32_t), TUPLE_INT },
+  [KEY_HOUR_SUMMARY] = { offsetof(WeatherSnapshot, summary), sizeof(((WeatherSnapshot*) 0)->summary), TUPLE_CSTRING },
+  [KEY_WIND_SPEED] = { offsetof(WeatherSnapshot, wind_speed), sizeof(((WeatherSnapshot*) 0)->wind_speed), TUPLE_CSTRING },
+  [KEY_WIND_BEARING] = { offsetof(WeatherSnapshot, wind_bearing), sizeof(int16_t), TUPLE_INT }
+};
+
+static WeatherSnapshot s_state;
+static WeatherChangedHandler s_handler = NULL;
+
+// The next update is never more than a poll away, so changes only go to
+// flash with whatever else is being written.
+static void store(void) {
+  storage_write(StorageWeather, &s_state, sizeof(s_state), StorageChangeMinor);
+}
+
+static int32_t tuple_int(const Tuple* tuple) {
+  switch (tuple->length) {
+    case 1:
+      return tuple->value->int8;
+    case 2:
+      return tuple->value->int16;
+    default:
+      return tuple->value->int32;
+  }
+}
+
+// Writes an integer into a field of its own width, returning whether it changed.
+static bool store_int(const Field* field, int32_t value) {
+  uint8_t* dest = (uint8_t*) &s_state + field->offset;
+  if (field->size == sizeof(int16_t)) {
+    int16_t narrow = value;
+    if (memcmp(dest, &narrow, sizeof(narrow)) == 0) {
+      return false;
+    }
+    memcpy(dest, &narrow, sizeof(narrow));
+  } else {
+    if (memcmp(dest, &value, sizeof(value)) == 0) {
+      return false;
+    }
+    memcpy(dest, &value, sizeof(value));
+  }
+  return true;
+}
+
+static bool store_string(const Field* field, const char* value) {
+  char* dest = (char*) &s_state + field->offset;
+  if (strncmp(dest, value, field->size - 1) == 0) {
+    return false;
+  }
+  strncpy(dest, value, field->size - 1);
+  dest[field->size - 1] = '\0';
+  return true;
+}
+
+static void changed(WeatherKey key) {
+  store();
+  if (s_handler) {
+    s_handler(key, &s_state);
+  }
+}
+
+void weather_state_init(WeatherChangedHandler handler) {
+  memset(&s_state, 0, sizeof(s_state));
+  s_handler = handler;
+
+  if (!storage_read(StorageWeather, &s_state, sizeof(s_state))) {
+    memset(&s_state, 0, sizeof(s_state));
+    return;
+  }
+  // Seed the display with what we showed last time.
+  for (int key = 0; key < WEATHER_KEY_COUNT; key++) {
+    s_handler(key, &s_state);
+  }
+}
+
+void weather_state_deinit(void) {
+  s_handler = NULL;
+}
+
+const WeatherSnapshot* weather_state_get(void) {
+  return &s_state;
+}
+
+bool weather_state_apply_tuple(const Tuple* tuple) {
+  if (tuple->key >= WEATHER_KEY_COUNT) {
+    return false;
+  }
+  const Field* field = &FIELDS[tuple->key];
+  bool did_change;
+  if (field->type == TUPLE_CSTRING) {
+    if (tuple->type == TUPLE_CSTRING) {
+      did_change = store_string(field, tuple->value->cstring);
+    } else if (tuple->type == TUPLE_BYTE_ARRAY) {
+      // Text sent as summary tokens; see summary_words.h.
+      char text[sizeof(((WeatherSnapshot*) 0)->summary)];
+      summary_words_expand(tuple->value->data, tuple->length, text, field->size < sizeof(text) ? field->size : sizeof(text));
+      did_change = store_string(field, text);
+    } else {
+      return false;
+    }
+  } else {
+    did_change = store_int(field, tuple_int(tuple));
+  }
+
+  if (did_change) {
+    changed(tuple->key);
+  }
+  return did_change;
+}
+
+bool weather_state_apply_snapshot(const WeatherSnapshot* snapshot) {
+  bool any_changed = false;
+  for (int key = 0; key < WEATHER_KEY_COUNT; key++) {
+    const Field* field = &FIELDS[key];
+    const uint8_t* source = (const uint8_t*) snapshot + field->offset;
+    uint8_t* dest = (uint8_t*) &s_state + field->offset;
+    if (memcmp(dest, source, field->size) != 0) {
+      memcpy(dest, source, field->size);
+      if (field->type == TUPLE_CSTRING) {
+        dest[field->size - 1] = '\0';
+      }
+      changed(key);
+      any_changed = true;
+    }
+  }
+  weather_state_touch(snapshot->fetched_at);
+  return any_changed;
+}
+
+// Records when the phone last confirmed the weather, changed or not.
+void weather_state_touch(uint32_t fetched_at) {
+  if (fetched_at != s_state.fetched_at) {
+    s_state.fetched_at = fetched_at;
+    store();
+  }
+}
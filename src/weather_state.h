@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pebble.h>
+#include "worker_protocol.h"
+
+// AppMessage keys sent by src/js/pebble-js-app.js.
+typedef enum {
+  KEY_TEMPERATURE = 0,
+  KEY_HOUR_FROM,
+  KEY_HOUR_SUMMARY,
+  KEY_WIND_SPEED,
+  KEY_WIND_BEARING,
+  WEATHER_KEY_COUNT
+} WeatherKey;
+
+// Keys the phone sends alongside the weather. Updates only carry the keys
+// that changed since the last one the watch acknowledged, numbered so the
+// watch can spot one going missing; a full update resets the count.
+enum {
+  KEY_SEQUENCE = WEATHER_KEY_COUNT,
+  KEY_FULL_UPDATE,
+  KEY_WEATHER_ERROR,
+  // Chunks of a payload too big for one message; see transfer.h.
+  KEY_TRANSFER_ID,
+  KEY_TRANSFER_CHUNK,
+  KEY_TRANSFER_LENGTH,
+  KEY_TRANSFER_DATA,
+  // Where the forecast is for, in ten-thousandths of a degree.
+  KEY_LATITUDE,
+  KEY_LONGITUDE,
+  // The next hour's rain, minute by minute; see precipitation.h.
+  KEY_PRECIPITATION
+};
+
+// Why the phone couldn't get the weather, sent as KEY_WEATHER_ERROR.
+typedef enum {
+  WeatherErrorNone = 0,
+  WeatherErrorLocation,
+  WeatherErrorTimeout,
+  WeatherErrorHttp,
+  WeatherErrorParse,
+  WeatherErrorNoKey  // the phone has lost the key, so shake hands again
+} WeatherError;
+
+// Called once for each key whose value actually changed.
+typedef void (*WeatherChangedHandler)(WeatherKey key, const WeatherSnapshot* state);
+
+void weather_state_init(WeatherChangedHandler handler);
+void weather_state_deinit(void);
+const WeatherSnapshot* weather_state_get(void);
+bool weather_state_apply_tuple(const Tuple* tuple);
+bool weather_state_apply_snapshot(const WeatherSnapshot* snapshot);
+void weather_state_touch(uint32_t fetched_at);
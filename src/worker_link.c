@@ -0,0 +1,74 @@
+#include "worker_link.h"
+
+// A freshly launched worker may take a moment to start listening.
+#define REPLY_TIMEOUT_MS 1500
+
+static WorkerSnapshotHandler s_handler = NULL;
+static AppTimer* s_timeout = NULL;
+static WeatherSnapshot s_staging;
+
+static void finish(const WeatherSnapshot* snapshot) {
+  if (s_timeout) {
+    app_timer_cancel(s_timeout);
+    s_timeout = NULL;
+  }
+  WorkerSnapshotHandler handler = s_handler;
+  s_handler = NULL;
+  if (handler) {
+    handler(snapshot);
+  }
+}
+
+static void handle_timeout(void* data) {
+  s_timeout = NULL;
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "no snapshot from worker");
+  finish(NULL);
+}
+
+static void handle_worker_message(uint16_t type, AppWorkerMessage* data) {
+  switch (weather_snapshot_receive(&s_staging, type, data)) {
+    case SnapshotComplete:
+      finish(&s_staging);
+      break;
+    case SnapshotEmpty:
+    case SnapshotCorrupt:
+      finish(NULL);
+      break;
+    default:
+      break;
+  }
+}
+
+void worker_link_init(WorkerSnapshotHandler handler) {
+  s_handler = handler;
+  app_worker_message_subscribe(handle_worker_message);
+  if (!app_worker_is_running()) {
+    app_worker_launch();
+  }
+
+  AppWorkerMessage request = { 0 };
+  app_worker_send_message(WORKER_MSG_REQUEST_SNAPSHOT, &request);
+  s_timeout = app_timer_register(REPLY_TIMEOUT_MS, handle_timeout, NULL);
+}
+
+void worker_link_deinit(void) {
+  if (s_timeout) {
+    app_timer_cancel(s_timeout);
+    s_timeout = NULL;
+  }
+  s_handler = NULL;
+  app_worker_message_unsubscribe();
+}
+
+void worker_link_publish(const WeatherSnapshot* snapshot) {
+  weather_snapshot_send(snapshot);
+}
+
+// Much cheaper than publishing when only the timestamp moved.
+void worker_link_touch(uint32_t fetched_at) {
+  AppWorkerMessage message = {
+    .data0 = fetched_at & 0xffff,
+    .data1 = fetched_at >> 16
+  };
+  app_worker_send_message(WORKER_MSG_SNAPSHOT_TOUCH, &message);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <pebble.h>
+#include "worker_protocol.h"
+
+// Called once after init with the worker's snapshot, or NULL if it had none
+// or didn't answer in time.
+typedef void (*WorkerSnapshotHandler)(const WeatherSnapshot* snapshot);
+
+void worker_link_init(WorkerSnapshotHandler handler);
+void worker_link_deinit(void);
+void worker_link_publish(const WeatherSnapshot* snapshot);
+void worker_link_touch(uint32_t fetched_at);
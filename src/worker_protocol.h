@@ -0,0 +1,99 @@
+#pragma once
+
+// Shared by the watchface (src/) and its background worker (worker_src/).
+// Include pebble.h or pebble_worker.h before this file.
+
+#define WORKER_SNAPSHOT_PERSIST_KEY 100
+
+// How old a snapshot may be before the face asks the phone for a new one.
+#define WORKER_SNAPSHOT_MAX_AGE (10 * 60)
+
+// Raw values of the last weather update, as received from the phone.
+typedef struct __attribute__((__packed__)) {
+  uint32_t fetched_at;  // 0 when there is no snapshot
+  int32_t hour_from;
+  int16_t temperature;
+  int16_t wind_bearing;
+  char wind_speed[8];
+  char summary[86];
+} WeatherSnapshot;
+
+// An AppWorkerMessage only carries six bytes, so a snapshot is streamed
+// as CHUNK messages of four bytes each, then an END carrying its length
+// (0 when there is nothing to send) and a checksum.
+enum {
+  WORKER_MSG_REQUEST_SNAPSHOT = 1,  // app -> worker
+  WORKER_MSG_SNAPSHOT_CHUNK,        // data0: byte offset, data1-2: bytes
+  WORKER_MSG_SNAPSHOT_END,          // data0: length, data1: checksum
+  WORKER_MSG_SNAPSHOT_TOUCH         // app -> worker, data0-1: fetched_at
+};
+
+typedef enum {
+  SnapshotPending,
+  SnapshotComplete,
+  SnapshotEmpty,
+  SnapshotCorrupt
+} SnapshotStatus;
+
+static inline uint16_t weather_snapshot_checksum(const WeatherSnapshot* snapshot) {
+  const uint8_t* bytes = (const uint8_t*) snapshot;
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (size_t i = 0; i < sizeof(WeatherSnapshot); i++) {
+    sum1 = (sum1 + bytes[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+static inline void weather_snapshot_send(const WeatherSnapshot* snapshot) {
+  AppWorkerMessage message;
+  if (snapshot->fetched_at == 0) {
+    message = (AppWorkerMessage) { .data0 = 0 };
+    app_worker_send_message(WORKER_MSG_SNAPSHOT_END, &message);
+    return;
+  }
+
+  const uint8_t* bytes = (const uint8_t*) snapshot;
+  for (size_t offset = 0; offset < sizeof(WeatherSnapshot); offset += 4) {
+    uint8_t chunk[4] = { 0 };
+    size_t length = sizeof(WeatherSnapshot) - offset;
+    memcpy(chunk, &bytes[offset], length < 4 ? length : 4);
+    message = (AppWorkerMessage) {
+      .data0 = offset,
+      .data1 = chunk[0] | (chunk[1] << 8),
+      .data2 = chunk[2] | (chunk[3] << 8)
+    };
+    app_worker_send_message(WORKER_MSG_SNAPSHOT_CHUNK, &message);
+  }
+  message = (AppWorkerMessage) {
+    .data0 = sizeof(WeatherSnapshot),
+    .data1 = weather_snapshot_checksum(snapshot)
+  };
+  app_worker_send_message(WORKER_MSG_SNAPSHOT_END, &message);
+}
+
+// Feed every worker message through here; chunks build up in staging and
+// it is only trusted once the END message's length and checksum match.
+static inline SnapshotStatus weather_snapshot_receive(WeatherSnapshot* staging, uint16_t type, AppWorkerMessage* data) {
+  uint8_t* bytes = (uint8_t*) staging;
+  switch (type) {
+    case WORKER_MSG_SNAPSHOT_CHUNK:
+      if (data->data0 < sizeof(WeatherSnapshot)) {
+        uint8_t chunk[4] = { data->data1 & 0xff, data->data1 >> 8, data->data2 & 0xff, data->data2 >> 8 };
+        size_t length = sizeof(WeatherSnapshot) - data->data0;
+        memcpy(&bytes[data->data0], chunk, length < 4 ? length : 4);
+      }
+      return SnapshotPending;
+    case WORKER_MSG_SNAPSHOT_END:
+      if (data->data0 == 0) {
+        return SnapshotEmpty;
+      }
+      if (data->data0 != sizeof(WeatherSnapshot) || data->data1 != weather_snapshot_checksum(staging)) {
+        return SnapshotCorrupt;
+      }
+      return SnapshotComplete;
+    default:
+      return SnapshotPending;
+  }
+}
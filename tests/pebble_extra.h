@@ -36,6 +36,32 @@ src/pebble-extra.h
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+// What the code under test has done to persistent storage since the last
+// persist_init() or persist_reset().
+typedef struct {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t deletes;
+  uint32_t bytes_written;
+} PersistStats;
+
+// Zeroes the counters and injected latency, keeping the stored values.
 void persist_reset(void);
+// Empty storage, zeroed counters, no latency.
 void persist_init(void);
-void persist_clear(void);
\ No newline at end of file
+// Drops every stored value.
+void persist_clear(void);
+PersistStats persist_stats(void);
+// Makes each read, or each write and delete, take this long.
+void persist_set_latency(uint32_t read_ns, uint32_t write_ns);
+
+// Makes data_logging_create() succeed or return NULL, and zeroes the count.
+void data_logging_set_available(bool available);
+// Items handed to data_logging_log() since data_logging_set_available().
+uint32_t data_logging_items(void);
+
+// What battery_state_service_peek() reports; fully charged until set.
+void battery_set_charge(BatteryChargeState charge);
@@ -0,0 +1,40 @@
+// Host versions of the SDK functions the tested sources call.
+
+#include <math.h>
+#include <pebble.h>
+
+#define TAU 6.283185307179586
+
+// The watch uses a lookup table; rounding to the same scale is close enough.
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t) lround(sin(TAU * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t) lround(cos(TAU * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t atan2_lookup(int16_t y, int16_t x) {
+  double angle = atan2(y, x) / TAU * TRIG_MAX_ANGLE;
+  return (int32_t) lround(angle < 0 ? angle + TRIG_MAX_ANGLE : angle);
+}
+
+// Logging goes nowhere on the host; tests report through their own output.
+void app_log(uint8_t log_level, const char* src_filename, int src_line_number, const char* fmt, ...) {
+}
+
+static BatteryChargeState s_battery = { .charge_percent = 100 };
+
+void battery_set_charge(BatteryChargeState charge) {
+  s_battery = charge;
+}
+
+BatteryChargeState battery_state_service_peek(void) {
+  return s_battery;
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+}
+
+void battery_state_service_unsubscribe(void) {
+}
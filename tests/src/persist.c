@@ -0,0 +1,185 @@
+// Host persistent storage: an in-memory map with the watch's limits, counting
+// what the code under test does to it and, if asked, making each call as
+// slow as flash.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pebble.h>
+#include <time.h>
+#include "pebble_extra.h"
+
+// The SDK's limit on all of an app's values together.
+#define PERSIST_TOTAL_MAX 4096
+#define PERSIST_SLOTS 128
+
+typedef struct {
+  bool used;
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} Slot;
+
+static Slot s_slots[PERSIST_SLOTS];
+static PersistStats s_stats;
+static uint32_t s_read_latency_ns = 0;
+static uint32_t s_write_latency_ns = 0;
+
+static void delay(uint32_t ns) {
+  if (ns) {
+    struct timespec wait = { ns / 1000000000, ns % 1000000000 };
+    nanosleep(&wait, NULL);
+  }
+}
+
+static Slot* find(uint32_t key) {
+  for (int i = 0; i < PERSIST_SLOTS; i++) {
+    if (s_slots[i].used && s_slots[i].key == key) {
+      return &s_slots[i];
+    }
+  }
+  return NULL;
+}
+
+static size_t total_size(void) {
+  size_t total = 0;
+  for (int i = 0; i < PERSIST_SLOTS; i++) {
+    total += s_slots[i].used ? s_slots[i].size : 0;
+  }
+  return total;
+}
+
+static Slot* read_slot(uint32_t key) {
+  s_stats.reads++;
+  delay(s_read_latency_ns);
+  return find(key);
+}
+
+// Values over PERSIST_DATA_MAX_LENGTH are refused rather than truncated, so
+// a layout that has outgrown a key fails loudly.
+static int write_slot(uint32_t key, const void* data, size_t size) {
+  s_stats.writes++;
+  delay(s_write_latency_ns);
+  if (size > PERSIST_DATA_MAX_LENGTH) {
+    return E_INVALID_ARGUMENT;
+  }
+  Slot* slot = find(key);
+  size_t others = total_size() - (slot ? slot->size : 0);
+  if (others + size > PERSIST_TOTAL_MAX) {
+    return E_OUT_OF_STORAGE;
+  }
+  for (int i = 0; !slot && i < PERSIST_SLOTS; i++) {
+    if (!s_slots[i].used) {
+      slot = &s_slots[i];
+    }
+  }
+  if (!slot) {
+    return E_OUT_OF_STORAGE;
+  }
+  slot->used = true;
+  slot->key = key;
+  slot->size = size;
+  memcpy(slot->data, data, size);
+  s_stats.bytes_written += size;
+  return (int) size;
+}
+
+void persist_init(void) {
+  persist_clear();
+  persist_reset();
+}
+
+void persist_clear(void) {
+  memset(s_slots, 0, sizeof(s_slots));
+}
+
+void persist_reset(void) {
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_read_latency_ns = 0;
+  s_write_latency_ns = 0;
+}
+
+PersistStats persist_stats(void) {
+  return s_stats;
+}
+
+void persist_set_latency(uint32_t read_ns, uint32_t write_ns) {
+  s_read_latency_ns = read_ns;
+  s_write_latency_ns = write_ns;
+}
+
+bool persist_exists(const uint32_t key) {
+  return find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+  Slot* slot = find(key);
+  return slot ? slot->size : E_DOES_NOT_EXIST;
+}
+
+bool persist_read_bool(const uint32_t key) {
+  Slot* slot = read_slot(key);
+  return slot && slot->size >= 1 && slot->data[0];
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  Slot* slot = read_slot(key);
+  int32_t value = 0;
+  if (slot && slot->size == sizeof(value)) {
+    memcpy(&value, slot->data, sizeof(value));
+  }
+  return value;
+}
+
+int persist_read_data(const uint32_t key, void* buffer, const size_t buffer_size) {
+  Slot* slot = read_slot(key);
+  if (!slot) {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = slot->size < buffer_size ? slot->size : buffer_size;
+  memcpy(buffer, slot->data, size);
+  return (int) size;
+}
+
+int persist_read_string(const uint32_t key, char* buffer, const size_t buffer_size) {
+  Slot* slot = read_slot(key);
+  if (!slot) {
+    return E_DOES_NOT_EXIST;
+  }
+  if (buffer_size == 0) {
+    return 0;
+  }
+  size_t size = slot->size < buffer_size ? slot->size : buffer_size;
+  memcpy(buffer, slot->data, size);
+  buffer[size - 1] = '\0';
+  return (int) size;
+}
+
+status_t persist_write_bool(const uint32_t key, const bool value) {
+  uint8_t byte = value;
+  int result = write_slot(key, &byte, sizeof(byte));
+  return result < 0 ? result : S_SUCCESS;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  int result = write_slot(key, &value, sizeof(value));
+  return result < 0 ? result : S_SUCCESS;
+}
+
+int persist_write_data(const uint32_t key, const void* data, const size_t size) {
+  return write_slot(key, data, size);
+}
+
+int persist_write_string(const uint32_t key, const char* cstring) {
+  return write_slot(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key) {
+  Slot* slot = find(key);
+  s_stats.deletes++;
+  delay(s_write_latency_ns);
+  if (!slot) {
+    return E_DOES_NOT_EXIST;
+  }
+  slot->used = false;
+  return S_SUCCESS;
+}
@@ -38,6 +38,18 @@ dist/tests/tests.c
 #include <pebble_extra.h>
 
 #include "unit.h"
+#include "transfer.h"
+#include "transfer_link.h"
+#include "forecast.h"
+#include "summary_words.h"
+#include "tide.h"
+#include "sun.h"
+#include "precipitation.h"
+#include "storage.h"
+#include "telemetry.h"
+#include "power_policy.h"
+#include "num2words.h"
+#include <math.h>
 
 #define VERSION_LABEL "1.0.0"
 
@@ -53,7 +65,670 @@ static void after_each(void) {
   persist_clear();
 }
 
+static Transfer transfer;
+static uint8_t payload[TRANSFER_BUFFER_SIZE];
+
+static void fill_payload(uint16_t length) {
+  for (uint16_t i = 0; i < length; i++) {
+    payload[i] = (uint8_t) (i * 31 + 7);
+  }
+}
+
+static TransferResult send_chunk(uint16_t id, uint16_t index, uint16_t length) {
+  uint16_t offset = index * TRANSFER_CHUNK_SIZE;
+  uint16_t size = length - offset < TRANSFER_CHUNK_SIZE ? length - offset : TRANSFER_CHUNK_SIZE;
+  return transfer_receive_chunk(&transfer, id, index, length, &payload[offset], size);
+}
+
+static char* test_transfer_reassembles_out_of_order(void) {
+  uint16_t length = 3 * TRANSFER_CHUNK_SIZE - 100;
+  fill_payload(length);
+  transfer_reset(&transfer);
+  mu_assert(send_chunk(1, 2, length) == TransferInProgress, "last chunk first should be in progress");
+  mu_assert(send_chunk(1, 0, length) == TransferInProgress, "first chunk should be in progress");
+  mu_assert(send_chunk(1, 0, length) == TransferInProgress, "duplicate chunk should be harmless");
+  mu_assert(send_chunk(1, 1, length) == TransferComplete, "final missing chunk should complete");
+  mu_assert(send_chunk(1, 1, length) == TransferDuplicate, "a late resend should not complete it again");
+  mu_assert(memcmp(transfer.buffer, payload, length) == 0, "reassembled payload should match");
+  return 0;
+}
+
+static char* test_transfer_reports_missing_chunk(void) {
+  uint16_t length = 4 * TRANSFER_CHUNK_SIZE;
+  fill_payload(length);
+  transfer_reset(&transfer);
+  mu_assert(transfer_next_missing(&transfer) == -1, "idle transfer has nothing missing");
+  send_chunk(7, 0, length);
+  send_chunk(7, 2, length);
+  mu_assert(transfer_next_missing(&transfer) == 1, "chunk 1 should be missing");
+  mu_assert(transfer_is_active(&transfer), "transfer should still be active");
+  send_chunk(8, 0, length);
+  mu_assert(transfer.id == 8 && transfer_next_missing(&transfer) == 1, "new id should restart reassembly");
+  return 0;
+}
+
+static char* test_transfer_rejects_bad_chunks(void) {
+  transfer_reset(&transfer);
+  mu_assert(transfer_receive_chunk(&transfer, 1, 0, TRANSFER_BUFFER_SIZE + 1, payload, TRANSFER_CHUNK_SIZE) == TransferRejected,
+            "oversized transfer should be rejected");
+  mu_assert(transfer_receive_chunk(&transfer, 1, 5, 600, payload, 88) == TransferRejected,
+            "out of range chunk should be rejected");
+  mu_assert(transfer_receive_chunk(&transfer, 1, 0, 600, payload, 100) == TransferRejected,
+            "short chunk should be rejected");
+  return 0;
+}
+
+// CPU cost of reassembling a full buffer on the host: the copying alone,
+// with no link in the way, so this is not the transfer's throughput.
+static char* test_transfer_reassembly_benchmark(void) {
+  uint16_t length = TRANSFER_BUFFER_SIZE;
+  fill_payload(length);
+  mu_bench_bytes("transfer_reassembly_cpu", length, {
+    uint16_t id = mu_i % 65535 + 1;
+    for (uint16_t index = 0; index < TRANSFER_MAX_CHUNKS; index++) {
+      send_chunk(id, index, length);
+    }
+  });
+  mu_assert(memcmp(transfer.buffer, payload, length) == 0, "reassembled payload should match");
+  return 0;
+}
+
+// A Bluetooth link as the transfer sees it. Every AppMessage costs its
+// bytes at the link's rate plus a round trip for the ack, and the phone
+// sends the next chunk only once the last is acked (or nacked).
+typedef struct {
+  uint32_t bytes_per_sec;
+  uint32_t round_trip_ms;
+  uint8_t lose_every;  // every Nth chunk message is lost, 0 for none
+} LinkModel;
+
+// Dictionary header plus four tuple headers and the three small values.
+#define LINK_CHUNK_OVERHEAD 34
+// The watch's resend request: two small tuples.
+#define LINK_REQUEST_SIZE 18
+
+static uint32_t link_message_ms(const LinkModel* link, uint16_t bytes) {
+  return bytes * 1000 / link->bytes_per_sec + link->round_trip_ms;
+}
+
+// Plays the phone's sendChunk() loop and transfer_link's resend logic
+// against transfer.c on a virtual clock: a gap is asked about once when a
+// later chunk shows it up, or after the chunk timeout when nothing follows
+// it. Returns the ms taken, or 0 if the watch gave up.
+static uint32_t simulate_link(const LinkModel* link, uint16_t id, uint16_t length) {
+  transfer_reset(&transfer);
+  int queue[4 * TRANSFER_MAX_CHUNKS];
+  int head = 0;
+  int tail = 0;
+  for (int index = 0; index * TRANSFER_CHUNK_SIZE < length; index++) {
+    queue[tail++] = index;
+  }
+  uint32_t elapsed = 0;
+  uint32_t sent = 0;
+  int requested = -1;
+  int retries = 0;
+  for (;;) {
+    if (head == tail) {
+      // Nothing more coming; the watch's timeout asks for the gap.
+      if (retries++ >= TRANSFER_LINK_MAX_RETRIES) {
+        return 0;
+      }
+      elapsed += TRANSFER_LINK_CHUNK_TIMEOUT_MS + link_message_ms(link, LINK_REQUEST_SIZE);
+      requested = transfer_next_missing(&transfer);
+      head = tail = 0;
+      queue[tail++] = requested;
+      continue;
+    }
+    int index = queue[head++];
+    uint16_t offset = index * TRANSFER_CHUNK_SIZE;
+    uint16_t size = length - offset < TRANSFER_CHUNK_SIZE ? length - offset : TRANSFER_CHUNK_SIZE;
+    elapsed += link_message_ms(link, LINK_CHUNK_OVERHEAD + size);
+    if (link->lose_every && ++sent % link->lose_every == 0) {
+      continue;
+    }
+    int expected = transfer.id == id ? transfer_next_missing(&transfer) : 0;
+    TransferResult result = transfer_receive_chunk(&transfer, id, index, length, &payload[offset], size);
+    if (result == TransferComplete) {
+      return elapsed;
+    }
+    if (result == TransferInProgress && expected >= 0 && index > expected && expected != requested &&
+        tail < (int) (sizeof(queue) / sizeof(queue[0]))) {
+      requested = expected;
+      elapsed += link_message_ms(link, LINK_REQUEST_SIZE);
+      queue[tail++] = expected;
+    }
+  }
+}
+
+// Not a pass/fail test; reports the bytes per second a full transfer gets
+// through a modelled link, clean and lossy. The link figures are
+// assumptions, not measurements: a few KB/s and tens of ms per ack.
+static char* test_transfer_throughput(void) {
+  uint16_t length = TRANSFER_BUFFER_SIZE;
+  fill_payload(length);
+  const LinkModel clean = { .bytes_per_sec = 8000, .round_trip_ms = 60, .lose_every = 0 };
+  const LinkModel lossy = { .bytes_per_sec = 8000, .round_trip_ms = 60, .lose_every = 5 };
+  uint32_t clean_ms = simulate_link(&clean, 1, length);
+  mu_assert(clean_ms > 0 && memcmp(transfer.buffer, payload, length) == 0, "a clean link should deliver the payload");
+  uint32_t lossy_ms = simulate_link(&lossy, 2, length);
+  mu_assert(lossy_ms > clean_ms && memcmp(transfer.buffer, payload, length) == 0,
+            "a lossy link should deliver the payload, more slowly");
+  // Losing the last chunk leaves no later one to show the gap up.
+  const LinkModel lose_last = { .bytes_per_sec = 8000, .round_trip_ms = 60, .lose_every = TRANSFER_MAX_CHUNKS };
+  mu_assert(simulate_link(&lose_last, 3, length) > TRANSFER_LINK_CHUNK_TIMEOUT_MS,
+            "a lost last chunk should be fetched again after the timeout");
+  printf(" - Transfer over a modelled link: %u bytes/s clean, %u bytes/s losing one chunk in %d\n",
+         (unsigned) (length * 1000u / clean_ms), (unsigned) (length * 1000u / lossy_ms), lossy.lose_every);
+  return 0;
+}
+
+static Forecast forecast;
+
+// kind, start 0x01020304, two hours: -3 "Rain", 12 ""
+static const uint8_t hourly[] = { TRANSFER_KIND_HOURLY, 0x04, 0x03, 0x02, 0x01, 2,
+                                  0xfd, 9, 90, 4, 'R', 'a', 'i', 'n',
+                                  12, 3, 45, 0 };
+
+// A full forecast as the phone sends it, for benchmarking the real size.
+static uint16_t fill_hourly(uint8_t* data) {
+  static const char* summaries[] = { "Mostly Cloudy", "Light Rain", "Partly Cloudy", "Clear", "Drizzle" };
+  uint16_t length = 0;
+  data[length++] = TRANSFER_KIND_HOURLY;
+  uint32_t start = 1700000000;
+  for (int i = 0; i < 4; i++) {
+    data[length++] = start >> (8 * i);
+  }
+  data[length++] = FORECAST_HOURS;
+  for (int hour = 0; hour < FORECAST_HOURS; hour++) {
+    const char* summary = summaries[hour % 5];
+    data[length++] = (uint8_t) (hour - 3);
+    data[length++] = 5 + hour;
+    data[length++] = 2 * hour + 100;
+    data[length++] = strlen(summary);
+    memcpy(&data[length], summary, strlen(summary));
+    length += strlen(summary);
+  }
+  return length;
+}
+
+static char* test_forecast_decodes_hours(void) {
+  mu_assert(forecast_decode(hourly, sizeof(hourly), &forecast), "hourly forecast should decode");
+  mu_assert(forecast.start == 0x01020304 && forecast.count == 2, "start and count should match");
+  mu_assert(forecast.hours[0].temperature == -3 && forecast.hours[0].wind_bearing_half == 90,
+            "first hour should match");
+  mu_assert(strcmp(forecast.hours[0].summary, "Rain") == 0, "summary should be terminated");
+  mu_assert(forecast.hours[1].temperature == 12 && forecast.hours[1].summary[0] == '\0',
+            "second hour should match");
+  mu_assert(!forecast_decode(hourly, sizeof(hourly) - 1, &forecast), "truncated forecast should fail");
+  return 0;
+}
+
+static char* test_forecast_hour_lookup(void) {
+  forecast_decode(hourly, sizeof(hourly), &forecast);
+  time_t start = forecast.start;
+  time_t hour_start;
+  mu_assert(forecast_hour_at(&forecast, start - 1, NULL) == NULL, "before the forecast has no hour");
+  mu_assert(forecast_hour_at(&forecast, start + 3599, &hour_start) == &forecast.hours[0] && hour_start == start,
+            "first hour should cover its whole hour");
+  mu_assert(forecast_hour_at(&forecast, start + 3600, &hour_start) == &forecast.hours[1] && hour_start == start + 3600,
+            "second hour should start on the hour");
+  mu_assert(forecast_hour_at(&forecast, start + 7200, NULL) == NULL, "past the forecast has no hour");
+  mu_assert(forecast_hours_left(&forecast, start + 10) == 1, "one whole hour should be left");
+  return 0;
+}
+
+static char* test_summary_words_expand(void) {
+  // Capital "light", "rain", "starting", "in", " 12", "min", "."
+  static const uint8_t tokens[] = { SUMMARY_TOKEN_CAPITAL, 0x81, 0x80, 0x88, 0x8b, ' ', '1', '2', 0x8f, '.' };
+  char text[40];
+  mu_assert(summary_words_expand(tokens, sizeof(tokens), text, sizeof(text)) == 30, "expanded length should match");
+  mu_assert(strcmp(text, "Light rain starting in 12 min.") == 0, "summary should expand");
+  char small[8];
+  summary_words_expand(tokens, sizeof(tokens), small, sizeof(small));
+  mu_assert(strcmp(small, "Light r") == 0, "expansion should truncate to fit");
+  static const uint8_t escaped[] = { SUMMARY_TOKEN_ESCAPE, 0xc3, SUMMARY_TOKEN_ESCAPE, 0xa9, 0xff };
+  summary_words_expand(escaped, sizeof(escaped), text, sizeof(text));
+  mu_assert(strcmp(text, "\xc3\xa9") == 0, "escaped bytes should pass through and unknown words be skipped");
+  return 0;
+}
+
+// Built by tools/tide_stations.py; the same bytes the watch loads.
+#define TIDE_RESOURCE "resources/data/tide_stations.bin"
+#define TAU 6.283185307179586
+
+static TideStation station;
+
+static bool load_station(void) {
+  uint8_t data[TIDE_HEADER_SIZE + TIDE_RECORD_SIZE];
+  FILE* file = fopen(TIDE_RESOURCE, "rb");
+  if (!file) {
+    return false;
+  }
+  size_t length = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  return tide_station_count(data, length) > 0 &&
+         tide_station_decode(&data[TIDE_HEADER_SIZE], length - TIDE_HEADER_SIZE, &station);
+}
+
+// The same sum in double precision, from the same constants.
+static double reference_height(time_t when) {
+  double elapsed = (double) (when - (time_t) station.epoch);
+  double height = station.datum_mm;
+  for (uint8_t i = 0; i < station.count; i++) {
+    const TideConstituent* c = &station.constituents[i];
+    double turns = (c->phase + c->rate * elapsed / (1 << TIDE_RATE_SHIFT)) / 4294967296.0;
+    height += c->amplitude_mm * cos(TAU * turns);
+  }
+  return height;
+}
+
+// Brute force: the first turning point after "from", to the second.
+static time_t reference_event(time_t from, bool* high) {
+  double before = reference_height(from + 1) - reference_height(from);
+  for (time_t t = from + 1; ; t++) {
+    double after = reference_height(t + 1) - reference_height(t);
+    if ((before > 0) != (after > 0)) {
+      *high = before > 0;
+      return t;
+    }
+    before = after;
+  }
+}
+
+static char* test_tide_resource_decodes(void) {
+  mu_assert(load_station(), "tide resource should decode");
+  mu_assert(strcmp(station.name, "Dover") == 0, "station name should match");
+  mu_assert(station.count > 0 && station.count <= TIDE_MAX_CONSTITUENTS, "station should have constituents");
+  uint8_t bad[TIDE_HEADER_SIZE] = { 'T', 'I', 'D', 'E', TIDE_VERSION + 1, 1, 0, 0 };
+  mu_assert(tide_station_count(bad, sizeof(bad)) == -1, "unknown version should be refused");
+  return 0;
+}
+
+static char* test_tide_height_matches_reference(void) {
+  load_station();
+  double worst = 0;
+  // A month either side of the epoch, and a few years on.
+  time_t starts[] = { station.epoch - 30 * 86400, station.epoch + 3 * 365 * 86400 };
+  for (int s = 0; s < 2; s++) {
+    for (time_t t = starts[s]; t < starts[s] + 60 * 86400; t += 1013) {
+      double error = fabs(tide_height_mm(&station, t) - reference_height(t));
+      worst = error > worst ? error : worst;
+    }
+  }
+  printf(" - Tide height: worst error %.1f mm\n", worst);
+  mu_assert(worst <= 5, "fixed-point height should be within 5mm of the reference");
+  return 0;
+}
+
+static char* test_tide_events_match_reference(void) {
+  load_station();
+  int worst = 0;
+  for (time_t from = station.epoch + 86400; from < station.epoch + 15 * 86400; from += 7 * 3600 + 11) {
+    TideEvent event;
+    mu_assert(tide_next_event(&station, from, &event), "there should be a tide within a day");
+    bool high;
+    time_t expected = reference_event(from, &high);
+    mu_assert(event.high == high, "event should be the same kind as the reference");
+    int error = abs((int) (event.time - expected));
+    worst = error > worst ? error : worst;
+    mu_assert(fabs(event.height_mm - reference_height(expected)) <= 5, "event height should match the reference");
+  }
+  printf(" - Tide events: worst error %d s\n", worst);
+  mu_assert(worst <= 120, "event times should be within two minutes of the reference");
+  return 0;
+}
+
+// The sunrise equation in doubles, for comparison.
+static bool reference_sun(int32_t day, double latitude, double longitude, double* sunrise, double* sunset) {
+  double rad = TAU / 360;
+  double noon = day + 0.5 - longitude / 360 - 10957.5;  // days from J2000
+  double m = fmod(357.5291 + 0.98560028 * noon, 360);
+  double centre = 1.9148 * sin(m * rad) + 0.0200 * sin(2 * m * rad) + 0.0003 * sin(3 * m * rad);
+  double ecliptic = fmod(m + centre + 180 + 102.9372, 360);
+  double transit = noon + 0.0053 * sin(m * rad) - 0.0069 * sin(2 * ecliptic * rad);
+  double declination = asin(sin(ecliptic * rad) * sin(23.4397 * rad));
+  double cos_hour = (sin(-0.833 * rad) - sin(latitude * rad) * sin(declination)) /
+                    (cos(latitude * rad) * cos(declination));
+  if (cos_hour <= -1 || cos_hour >= 1) {
+    return false;
+  }
+  double half_day = acos(cos_hour) / TAU;
+  *sunrise = (transit - half_day + 10957.5) * 86400;
+  *sunset = (transit + half_day + 10957.5) * 86400;
+  return true;
+}
+
+static char* test_sun_matches_reference(void) {
+  double worst = 0;
+  for (int32_t latitude_e4 = -600000; latitude_e4 <= 600000; latitude_e4 += 75000) {
+    int32_t longitude_e4 = latitude_e4 * 3 - 200000;
+    // Every few days through 2026.
+    for (int32_t day = 20454; day < 20454 + 365; day += 3) {
+      SunDay sun;
+      sun_day_compute(day, latitude_e4, longitude_e4, &sun);
+      double sunrise, sunset;
+      bool rises = reference_sun(day, latitude_e4 / 1e4, longitude_e4 / 1e4, &sunrise, &sunset);
+      mu_assert(rises == (sun.state == SunRisesAndSets), "sun state should match the reference");
+      if (rises) {
+        worst = fmax(worst, fmax(fabs(sun.sunrise - sunrise), fabs(sun.sunset - sunset)));
+      }
+    }
+  }
+  printf(" - Sunrise/sunset: worst error %.0f s\n", worst);
+  mu_assert(worst <= 60, "fixed-point sun times should be within a minute of the reference");
+
+  // London on 21 June 2026: sunrise 03:43, sunset 20:21 UTC.
+  SunDay london;
+  sun_day_compute(20625, 515074, -1278, &london);
+  mu_assert(abs((int) london.sunrise - 1782013380) <= 120, "London sunrise should be about 03:43");
+  mu_assert(abs((int) london.sunset - 1782073260) <= 120, "London sunset should be about 20:21");
+  // Tromso in midwinter and midsummer.
+  SunDay tromso;
+  sun_day_compute(20443, 696492, 189553, &tromso);
+  mu_assert(tromso.state == SunAlwaysDown, "no sunrise in a Tromso midwinter");
+  sun_day_compute(20625, 696492, 189553, &tromso);
+  mu_assert(tromso.state == SunAlwaysUp, "no sunset in a Tromso midsummer");
+  return 0;
+}
+
+static char* test_sun_cache_rolls_days(void) {
+  SunCache cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.day = -1;
+  mu_assert(!sun_cache_update(&cache, 20625), "nothing to work out without a location");
+  mu_assert(sun_cache_set_location(&cache, 515074, -1278), "first location should be taken");
+  mu_assert(!sun_cache_set_location(&cache, 515074, -1278), "same location should change nothing");
+  mu_assert(sun_cache_update(&cache, 20625), "new day should be worked out");
+  mu_assert(!sun_cache_update(&cache, 20625), "same day should come from the cache");
+  SunDay tomorrow = cache.tomorrow;
+  sun_cache_update(&cache, 20626);
+  mu_assert(memcmp(&cache.today, &tomorrow, sizeof(SunDay)) == 0, "tomorrow should become today");
+
+  time_t when;
+  bool sunrise;
+  mu_assert(sun_cache_next_event(&cache, cache.today.sunrise - 1, &when, &sunrise) &&
+            sunrise && when == (time_t) cache.today.sunrise, "before dawn the sunrise is next");
+  mu_assert(sun_cache_next_event(&cache, cache.today.sunrise, &when, &sunrise) &&
+            !sunrise && when == (time_t) cache.today.sunset, "after dawn the sunset is next");
+  mu_assert(sun_cache_next_event(&cache, cache.today.sunset, &when, &sunrise) &&
+            sunrise && when == (time_t) cache.tomorrow.sunrise, "after dusk tomorrow's sunrise is next");
+  return 0;
+}
+
+static char* test_sun_benchmark(void) {
+  volatile uint32_t sink = 0;
+  mu_bench("sun_day_compute", {
+    SunDay sun;
+    sun_day_compute(20454 + mu_i % 365, 515074, -1278, &sun);
+    sink += sun.sunrise;
+  });
+  return 0;
+}
+
+static uint16_t fill_precipitation(uint8_t* data, uint32_t start, const char* minutes) {
+  data[0] = start;
+  data[1] = start >> 8;
+  data[2] = start >> 16;
+  data[3] = start >> 24;
+  uint16_t length = PRECIPITATION_HEADER_SIZE;
+  for (const char* m = minutes; *m; m++) {
+    data[length++] = *m == '#' ? 8 : *m == '.' ? 1 : 0;
+  }
+  return length;
+}
+
+static char* test_precipitation_finds_onset(void) {
+  uint8_t data[PRECIPITATION_HEADER_SIZE + PRECIPITATION_MAX_MINUTES];
+  const time_t start = 1700000000;
+  // '#' rain, '.' too light to count, ' ' dry.
+  uint16_t length = fill_precipitation(data, start, " .. ###  ##");
+  mu_assert(precipitation_next_onset(data, length, start) == start + 4 * 60, "first onset should be found");
+  mu_assert(precipitation_next_onset(data, length, start + 4 * 60) == start + 9 * 60,
+            "onsets already passed should be skipped");
+  mu_assert(precipitation_next_onset(data, length, start + 9 * 60) == 0, "nothing after the last onset");
+  length = fill_precipitation(data, start, "###   ");
+  mu_assert(precipitation_next_onset(data, length, start) == 0, "rain already falling isn't an onset");
+  mu_assert(precipitation_next_onset(data, PRECIPITATION_HEADER_SIZE, start) == 0, "empty series has no onset");
+  mu_assert(precipitation_end(data, length) == start + 6 * 60, "series should end after its last minute");
+  mu_assert(precipitation_end(data, PRECIPITATION_HEADER_SIZE) == 0, "empty series has no end");
+  return 0;
+}
+
+static char* test_storage_coalesces_writes(void) {
+  storage_init();
+  storage_take_write_count();
+  time_t now = time(NULL);
+  SunCache sun = { .have_location = true, .latitude_e4 = 511300, .longitude_e4 = 13100, .day = 20000 };
+  storage_write(StorageSun, &sun, sizeof(sun), StorageChangeMinor);
+  storage_flush(now + 60);
+  mu_assert(storage_take_write_count() == 0, "a minor change should wait for the interval");
+  storage_flush(now + STORAGE_MIN_WRITE_INTERVAL);
+  uint16_t pages = storage_take_write_count();
+  mu_assert(pages == 2, "the blob should take two persist values");
+
+  storage_write(StorageSun, &sun, sizeof(sun), StorageChangeMajor);
+  storage_flush(now + STORAGE_MIN_WRITE_INTERVAL + 60);
+  mu_assert(storage_take_write_count() == 0, "an unchanged section should not dirty the blob");
+  forecast_decode(hourly, sizeof(hourly), &forecast);
+  forecast_save(&forecast);
+  sun.day++;
+  storage_write(StorageSun, &sun, sizeof(sun), StorageChangeMinor);
+  storage_flush(now + STORAGE_MIN_WRITE_INTERVAL + 60);
+  mu_assert(storage_take_write_count() == pages, "a major change should write everything pending at once");
+
+  SunCache read;
+  mu_assert(storage_read(StorageSun, &read, sizeof(read)) && read.day == 20001, "sections should read back from RAM");
+  mu_assert(!storage_read(StorageSun, &read, sizeof(read) - 1), "a wrong size should be refused");
+  return 0;
+}
+
+static char* test_storage_survives_restart(void) {
+  storage_init();
+  forecast_decode(hourly, sizeof(hourly), &forecast);
+  forecast_save(&forecast);
+  storage_flush(time(NULL));
+  PersistStats written = persist_stats();
+  mu_assert(written.writes == 2 && written.bytes_written > PERSIST_DATA_MAX_LENGTH,
+            "the blob should go out as two full-sized writes");
+
+  persist_reset();
+  storage_init();
+  Forecast loaded;
+  forecast_load(&loaded);
+  mu_assert(memcmp(&loaded, &forecast, sizeof(Forecast)) == 0, "the forecast should come back after a restart");
+  PersistStats read = persist_stats();
+  mu_assert(read.reads == 2 && read.writes == 0 && read.deletes == 0, "startup should only read the blob's pages");
+  return 0;
+}
+
+static char* test_storage_rejects_torn_write(void) {
+  storage_init();
+  forecast_decode(hourly, sizeof(hourly), &forecast);
+  forecast_save(&forecast);
+  storage_flush(time(NULL));
+  uint8_t old_page[PERSIST_DATA_MAX_LENGTH];
+  int old_size = persist_read_data(STORAGE_PERSIST_KEY + 1, old_page, sizeof(old_page));
+
+  forecast.count--;
+  forecast_save(&forecast);
+  storage_flush(time(NULL));
+  // The watch died after writing the first page of the second flush.
+  persist_write_data(STORAGE_PERSIST_KEY + 1, old_page, old_size);
+  storage_init();
+  Forecast loaded;
+  forecast_load(&loaded);
+  mu_assert(loaded.count == 0, "pages from different flushes should not be mixed");
+
+  forecast_save(&forecast);
+  storage_flush(time(NULL));
+  uint8_t page[PERSIST_DATA_MAX_LENGTH];
+  int size = persist_read_data(STORAGE_PERSIST_KEY, page, sizeof(page));
+  page[size / 2] ^= 0x10;
+  persist_write_data(STORAGE_PERSIST_KEY, page, size);
+  storage_init();
+  forecast_load(&loaded);
+  mu_assert(loaded.count == 0, "a damaged page should not be trusted");
+  return 0;
+}
+
+// The host mock has to refuse what the watch would, or the storage tests
+// above prove nothing.
+static char* test_persist_enforces_limits(void) {
+  uint8_t value[PERSIST_DATA_MAX_LENGTH + 1];
+  memset(value, 0xa5, sizeof(value));
+  mu_assert(persist_write_data(1, value, sizeof(value)) == E_INVALID_ARGUMENT, "an oversized value should be refused");
+  mu_assert(!persist_exists(1), "a refused value should not be stored");
+  // 16 full values make the 4 KB the SDK allows an app.
+  for (uint32_t key = 1; key <= 16; key++) {
+    mu_assert(persist_write_data(key, value, PERSIST_DATA_MAX_LENGTH) == PERSIST_DATA_MAX_LENGTH,
+              "values up to the total should fit");
+  }
+  mu_assert(persist_write_data(17, value, 1) == E_OUT_OF_STORAGE, "a value past 4 KB should be refused");
+  mu_assert(persist_write_data(16, value, PERSIST_DATA_MAX_LENGTH) == PERSIST_DATA_MAX_LENGTH,
+            "rewriting a value in place should still fit");
+  mu_assert(persist_write_int(17, 1) == E_OUT_OF_STORAGE, "every kind of write should count against the total");
+  return 0;
+}
+
+// A flush with each write as slow as flash, so its cost follows the number
+// of pages rather than the copying.
+static char* test_storage_flush_benchmark(void) {
+  storage_init();
+  storage_take_write_count();
+  time_t now = time(NULL);
+  SunCache sun = { .have_location = true, .latitude_e4 = 511300, .longitude_e4 = 13100 };
+  persist_set_latency(0, 100000);
+  mu_bench("storage_flush", {
+    sun.day++;
+    storage_write(StorageSun, &sun, sizeof(sun), StorageChangeMajor);
+    storage_flush(now);
+  });
+  mu_assert(persist_stats().writes > 0 && storage_take_write_count() == persist_stats().writes,
+            "every flush should have written");
+  return 0;
+}
+
+static char* test_telemetry_without_data_logging(void) {
+  data_logging_set_available(false);
+  telemetry_init();
+  // Far more than a batch; with nowhere to flush to, none may be kept.
+  for (int i = 0; i < 10 * TELEMETRY_BATCH_SIZE; i++) {
+    telemetry_record(TelemetryRedraws, i, 0);
+  }
+  telemetry_deinit();
+  mu_assert(data_logging_items() == 0, "nothing should be logged without a session");
+
+  data_logging_set_available(true);
+  telemetry_init();
+  for (int i = 0; i < TELEMETRY_BATCH_SIZE + 1; i++) {
+    telemetry_record(TelemetryRedraws, i, 0);
+  }
+  mu_assert(data_logging_items() == TELEMETRY_BATCH_SIZE, "a full batch should be logged at once");
+  telemetry_deinit();
+  mu_assert(data_logging_items() == TELEMETRY_BATCH_SIZE + 1, "the rest should be logged on the way out");
+  return 0;
+}
+
+static PowerMode mode_at(int percent, bool charging, PowerMode current) {
+  BatteryChargeState charge = { .charge_percent = percent, .is_charging = charging };
+  return power_policy_mode_for(charge, current);
+}
+
+static char* test_power_mode_thresholds(void) {
+  mu_assert(mode_at(POWER_SAVER_THRESHOLD + 10, false, PowerModeNormal) == PowerModeNormal, "full battery is normal");
+  mu_assert(mode_at(POWER_SAVER_THRESHOLD, false, PowerModeNormal) == PowerModeSaver, "saver at its threshold");
+  mu_assert(mode_at(POWER_CRITICAL_THRESHOLD, false, PowerModeSaver) == PowerModeCritical,
+            "critical at its threshold");
+  mu_assert(mode_at(POWER_CRITICAL_THRESHOLD, true, PowerModeCritical) == PowerModeNormal, "charging is normal");
+  // Hysteresis: climbing back past a threshold isn't enough on its own.
+  int above_critical = POWER_CRITICAL_THRESHOLD + POWER_HYSTERESIS;
+  mu_assert(mode_at(above_critical, false, PowerModeCritical) == PowerModeCritical,
+            "critical should hold within the hysteresis");
+  mu_assert(mode_at(above_critical + 1, false, PowerModeCritical) == PowerModeSaver,
+            "critical should step up to saver past the hysteresis");
+  int above_saver = POWER_SAVER_THRESHOLD + POWER_HYSTERESIS;
+  mu_assert(mode_at(above_saver, false, PowerModeSaver) == PowerModeSaver, "saver should hold within the hysteresis");
+  mu_assert(mode_at(above_saver, false, PowerModeNormal) == PowerModeNormal,
+            "normal should not drop until the threshold");
+  mu_assert(mode_at(above_saver + 1, false, PowerModeSaver) == PowerModeNormal,
+            "saver should step up past the hysteresis");
+  return 0;
+}
+
+// In critical mode the time may skip a redraw only when the words wouldn't change.
+static char* test_power_critical_time_redraws(void) {
+  battery_set_charge((BatteryChargeState) { .charge_percent = POWER_CRITICAL_THRESHOLD });
+  power_policy_init(NULL);
+  mu_assert(power_policy_mode() == PowerModeCritical, "low battery should start in critical mode");
+  char shown[86] = "";
+  char words[86];
+  fuzzy_time_to_words(9, 59, shown, sizeof(shown));
+  int redraws = 0;
+  for (int minute = 0; minute < 60; minute++) {
+    struct tm tick = { .tm_hour = 10, .tm_min = minute };
+    memset(words, 0, sizeof(words));
+    fuzzy_time_to_words(10, minute, words, sizeof(words));
+    if (power_policy_should_update_time(&tick, minute == 0 ? MINUTE_UNIT | HOUR_UNIT : MINUTE_UNIT)) {
+      strcpy(shown, words);
+      redraws++;
+    }
+    mu_assert(strcmp(shown, words) == 0, "the face should never show words the time has moved past");
+  }
+  mu_assert(redraws == 36, "critical mode should skip the two minutes in five where the words stand still");
+  power_policy_deinit();
+  battery_set_charge((BatteryChargeState) { .charge_percent = 100 });
+  return 0;
+}
+
+// The rest of the work done on the watch every minute or every message.
+static char* test_hot_path_benchmarks(void) {
+  volatile int32_t sink = 0;
+  mu_assert(load_station(), "tide resource should decode");
+  time_t from = station.epoch + 86400;
+  mu_bench("tide_height_mm", sink += tide_height_mm(&station, from + mu_i % 86400));
+  TideEvent event;
+  mu_bench("tide_next_event", tide_next_event(&station, from + mu_i % 86400 * 60, &event));
+  uint8_t full[6 + FORECAST_HOURS * (4 + FORECAST_SUMMARY_SIZE)];
+  uint16_t full_length = fill_hourly(full);
+  mu_assert(forecast_decode(full, full_length, &forecast) && forecast.count == FORECAST_HOURS,
+            "a full forecast should decode");
+  mu_bench("forecast_decode", forecast_decode(full, full_length, &forecast));
+  static const uint8_t tokens[] = { SUMMARY_TOKEN_CAPITAL, 0x81, 0x80, 0x88, 0x8b, ' ', '1', '2', 0x8f, '.' };
+  char text[40];
+  mu_bench("summary_words_expand", summary_words_expand(tokens, sizeof(tokens), text, sizeof(text)));
+  uint8_t data[PRECIPITATION_HEADER_SIZE + PRECIPITATION_MAX_MINUTES];
+  uint16_t length = fill_precipitation(data, 1700000000, "    .. .. ..   .  ..  .  ...   ..   . .. ... .   ..   ##");
+  mu_bench("precipitation_next_onset", sink += precipitation_next_onset(data, length, 1700000000));
+  char words[86];
+  mu_bench("fuzzy_time_to_words", fuzzy_time_to_words(mu_i / 60 % 24, mu_i % 60, words, sizeof(words)));
+  return 0;
+}
+
 static char* all_tests() {
+  mu_run_test(test_transfer_reassembles_out_of_order);
+  mu_run_test(test_transfer_reports_missing_chunk);
+  mu_run_test(test_transfer_rejects_bad_chunks);
+  mu_run_test(test_transfer_reassembly_benchmark);
+  mu_run_test(test_transfer_throughput);
+  mu_run_test(test_forecast_decodes_hours);
+  mu_run_test(test_forecast_hour_lookup);
+  mu_run_test(test_summary_words_expand);
+  mu_run_test(test_tide_resource_decodes);
+  mu_run_test(test_tide_height_matches_reference);
+  mu_run_test(test_tide_events_match_reference);
+  mu_run_test(test_sun_matches_reference);
+  mu_run_test(test_sun_cache_rolls_days);
+  mu_run_test(test_sun_benchmark);
+  mu_run_test(test_precipitation_finds_onset);
+  mu_run_test(test_storage_coalesces_writes);
+  mu_run_test(test_storage_survives_restart);
+  mu_run_test(test_storage_rejects_torn_write);
+  mu_run_test(test_persist_enforces_limits);
+  mu_run_test(test_storage_flush_benchmark);
+  mu_run_test(test_telemetry_without_data_logging);
+  mu_run_test(test_power_mode_thresholds);
+  mu_run_test(test_power_critical_time_redraws);
+  mu_run_test(test_hot_path_benchmarks);
   return 0;
 }
 
@@ -61,7 +736,9 @@ int main(int argc, char **argv) {
   printf("%s----------------------------------\n", KCYN);
   printf(" Running YourApp %s Test Suite \n", VERSION_LABEL);
   printf("----------------------------------\n%s", KNRM);
+  mu_bench_begin();
   char* result = all_tests();
+  int regressions = mu_bench_end();
   if (0 != result) {
     printf("%s - Failed Test:%s %s\n", KRED, KNRM, result);
   }
@@ -69,5 +746,5 @@ int main(int argc, char **argv) {
   printf(" - Tests Passed: %s%d%s\n", (tests_run == tests_passed) ? KGRN : KRED, tests_passed, KNRM);
 
   printf("%s----------------------------------%s\n", KCYN, KNRM);
-  return result != 0;
+  return result != 0 || regressions != 0;
 }
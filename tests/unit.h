@@ -40,6 +40,12 @@ and has been modified for my purposes.
 
 #pragma once
 
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
 // Colour code definitions to make the output all pretty.
 #define KNRM  "\x1B[0m"
 #define KRED  "\x1B[31m"
@@ -69,3 +75,148 @@ and has been modified for my purposes.
 
 extern int tests_run;
 extern int tests_passed;
+
+// Benchmarks. mu_bench("name", body) runs the body enough times for one
+// sample to take MU_BENCH_SAMPLE_NS, takes MU_BENCH_SAMPLES samples and
+// reports min, median and p99 ns per iteration. The body can use mu_i, the
+// iteration number, and may contain commas. mu_bench_bytes("name", bytes,
+// body) does the same for a body that handles that many bytes, and reports
+// bytes per second as well.
+//
+// Call mu_bench_begin() before the tests and mu_bench_end() after; results go
+// to bench_output.txt as JSON. Set MU_BENCH_BASELINE to an earlier
+// bench_output.txt to compare medians against it; anything slower by more
+// than MU_BENCH_THRESHOLD percent (default 10) is flagged, and
+// mu_bench_end() returns how many were.
+//
+// Needs clock_gettime(), so build with _POSIX_C_SOURCE of 199309L or later.
+
+#define MU_BENCH_SAMPLES 100
+#define MU_BENCH_SAMPLE_NS 1000000
+#define MU_BENCH_OUTPUT "bench_output.txt"
+#define MU_BENCH_MAX 64
+
+#define mu_bench(name, ...) mu_bench_bytes(name, 0, __VA_ARGS__)
+
+#define mu_bench_bytes(name, bytes, ...) do { \
+  uint64_t mu_iterations = 1; \
+  for (;;) { \
+    uint64_t mu_start = mu_bench_now_ns(); \
+    for (uint64_t mu_i = 0; mu_i < mu_iterations; mu_i++) { \
+      __VA_ARGS__; \
+    } \
+    if (mu_bench_now_ns() - mu_start >= MU_BENCH_SAMPLE_NS || mu_iterations >= (1u << 30)) { \
+      break; \
+    } \
+    mu_iterations *= 2; \
+  } \
+  double mu_samples[MU_BENCH_SAMPLES]; \
+  for (int mu_sample = 0; mu_sample < MU_BENCH_SAMPLES; mu_sample++) { \
+    uint64_t mu_start = mu_bench_now_ns(); \
+    for (uint64_t mu_i = 0; mu_i < mu_iterations; mu_i++) { \
+      __VA_ARGS__; \
+    } \
+    mu_samples[mu_sample] = (double) (mu_bench_now_ns() - mu_start) / mu_iterations; \
+  } \
+  mu_bench_report(name, mu_samples, MU_BENCH_SAMPLES, mu_iterations, bytes); \
+} while (0)
+
+typedef struct {
+  char name[64];
+  double median_ns;
+} MuBenchResult;
+
+static FILE* mu_bench_file = NULL;
+static int mu_bench_count = 0;
+static int mu_bench_regressions = 0;
+static double mu_bench_threshold = 10;
+static MuBenchResult mu_bench_baseline[MU_BENCH_MAX];
+static int mu_bench_baseline_count = 0;
+
+static inline uint64_t mu_bench_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static inline int mu_bench_compare(const void* a, const void* b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+// Reads back the one-result-per-line format mu_bench_report() writes.
+static inline void mu_bench_load_baseline(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    printf("%s - No benchmark baseline at %s%s\n", KYEL, path, KNRM);
+    return;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file) && mu_bench_baseline_count < MU_BENCH_MAX) {
+    MuBenchResult* result = &mu_bench_baseline[mu_bench_baseline_count];
+    const char* median = strstr(line, "\"median_ns\":");
+    if (sscanf(line, " { \"name\": \"%63[^\"]\"", result->name) == 1 && median &&
+        sscanf(median, "\"median_ns\": %lf", &result->median_ns) == 1) {
+      mu_bench_baseline_count++;
+    }
+  }
+  fclose(file);
+}
+
+static inline void mu_bench_begin(void) {
+  const char* baseline = getenv("MU_BENCH_BASELINE");
+  const char* threshold = getenv("MU_BENCH_THRESHOLD");
+  if (threshold) {
+    mu_bench_threshold = atof(threshold);
+  }
+  if (baseline) {
+    mu_bench_load_baseline(baseline);
+  }
+  mu_bench_file = fopen(MU_BENCH_OUTPUT, "w");
+  if (mu_bench_file) {
+    fprintf(mu_bench_file, "{\n  \"benchmarks\": [\n");
+  }
+}
+
+// "bytes" is what one iteration handles, or 0 if throughput means nothing.
+static inline void mu_bench_report(const char* name, double* samples, int count, uint64_t iterations, uint32_t bytes) {
+  qsort(samples, count, sizeof(double), mu_bench_compare);
+  double min = samples[0];
+  double median = samples[count / 2];
+  double p99 = samples[(count * 99 + 99) / 100 - 1];
+  double bytes_per_sec = bytes / median * 1e9;
+  if (bytes) {
+    printf(" - Bench %s: %.1f ns/op (min %.1f, p99 %.1f), %.0f bytes/s\n", name, median, min, p99, bytes_per_sec);
+  } else {
+    printf(" - Bench %s: %.1f ns/op (min %.1f, p99 %.1f)\n", name, median, min, p99);
+  }
+  if (mu_bench_file) {
+    fprintf(mu_bench_file, "%s    { \"name\": \"%s\", \"iterations\": %llu, \"min_ns\": %.2f, \"median_ns\": %.2f, \"p99_ns\": %.2f",
+            mu_bench_count ? ",\n" : "", name, (unsigned long long) iterations, min, median, p99);
+    if (bytes) {
+      fprintf(mu_bench_file, ", \"bytes_per_sec\": %.0f", bytes_per_sec);
+    }
+    fprintf(mu_bench_file, " }");
+  }
+  mu_bench_count++;
+  for (int i = 0; i < mu_bench_baseline_count; i++) {
+    if (strcmp(mu_bench_baseline[i].name, name) == 0 &&
+        median > mu_bench_baseline[i].median_ns * (1 + mu_bench_threshold / 100)) {
+      printf("%s   regression: was %.1f ns/op, %+.0f%%%s\n", KRED, mu_bench_baseline[i].median_ns,
+             100 * (median / mu_bench_baseline[i].median_ns - 1), KNRM);
+      mu_bench_regressions++;
+    }
+  }
+}
+
+static inline int mu_bench_end(void) {
+  if (mu_bench_file) {
+    fprintf(mu_bench_file, "\n  ]\n}\n");
+    fclose(mu_bench_file);
+    mu_bench_file = NULL;
+  }
+  if (mu_bench_baseline_count) {
+    printf(" - Benchmark regressions: %s%d%s\n", mu_bench_regressions ? KRED : KGRN, mu_bench_regressions, KNRM);
+  }
+  return mu_bench_regressions;
+}
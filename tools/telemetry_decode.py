@@ -0,0 +1,41 @@
+#!/usr/bin/env python
+#
+# Turns telemetry downloaded from the watch into CSV.
+#
+# PebbleKit JS can't receive data logging sessions, so collect them with the
+# SDK tool instead, e.g.
+#
+#   pebble data-logging list          # find the session tagged 0x71d3
+#   pebble data-logging download --session-id <id> telemetry.bin
+#   tools/telemetry_decode.py telemetry.bin > telemetry.csv
+#
+# The record layout must match TelemetryRecord in src/telemetry.h.
+#
+
+import csv
+import struct
+import sys
+
+RECORD = struct.Struct('<IHHi')
+KINDS = {1: 'weather_latency_ms', 2: 'battery_percent', 3: 'redraws', 4: 'first_paint_ms',
+         5: 'storage_writes'}
+
+def records(data):
+    for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        yield RECORD.unpack_from(data, offset)
+
+def main(paths):
+    out = csv.writer(sys.stdout)
+    out.writerow(['timestamp', 'kind', 'value', 'aux'])
+    for path in paths:
+        with open(path, 'rb') as f:
+            data = f.read()
+        if len(data) % RECORD.size:
+            sys.stderr.write('{}: trailing {} bytes ignored\n'.format(path, len(data) % RECORD.size))
+        for timestamp, kind, aux, value in records(data):
+            out.writerow([timestamp, KINDS.get(kind, kind), value, aux])
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.exit('usage: {} FILE...'.format(sys.argv[0]))
+    main(sys.argv[1:])
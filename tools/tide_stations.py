@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+#
+# Builds the TIDE_STATIONS resource from published harmonic constants.
+#
+#   tools/tide_stations.py tools/tide_stations.json resources/data/tide_stations.bin
+#
+# Each station lists amplitude (m) and Greenwich phase lag (degrees) per
+# constituent. The equilibrium arguments and nodal corrections are folded in
+# here, for midnight UTC on 1 January of the chosen epoch year, so the watch
+# only has to add up cosines. Nodal corrections drift slowly, so rebuild with
+# a new epoch every year or two.
+#
+# The layout must match src/tide.h.
+#
+
+import calendar
+import json
+import math
+import struct
+import sys
+
+VERSION = 1
+MAX_CONSTITUENTS = 16
+RATE_SHIFT = 12
+NAME_SIZE = 16
+
+HEADER = struct.Struct('<4sBBH')
+RECORD = struct.Struct('<{}sIhBx'.format(NAME_SIZE))
+CONSTITUENT = struct.Struct('<IIHxx')
+RECORD_SIZE = RECORD.size + MAX_CONSTITUENTS * CONSTITUENT.size
+
+# Speeds of the astronomical arguments, degrees per hour: lunar day T (from
+# midnight), mean longitudes of the moon s, sun h and lunar perigee p.
+SPEEDS = (15.0, 0.5490165, 0.0410686, 0.0046418)
+
+# Doodson multiples of (T, s, h, p) and the phase offset in degrees.
+CONSTITUENTS = {
+    'M2': ((2, -2, 2, 0), 0),
+    'S2': ((2, 0, 0, 0), 0),
+    'N2': ((2, -3, 2, 1), 0),
+    'K2': ((2, 0, 2, 0), 0),
+    'K1': ((1, 0, 1, 0), -90),
+    'O1': ((1, -2, 1, 0), 90),
+    'P1': ((1, 0, -1, 0), 90),
+    'Q1': ((1, -3, 1, 1), 90),
+    'M4': ((4, -4, 4, 0), 0),
+    'MS4': ((4, -2, 2, 0), 0),
+}
+
+def speed(name):
+    return sum(m * s for m, s in zip(CONSTITUENTS[name][0], SPEEDS))
+
+def longitudes(epoch):
+    # Mean longitudes in degrees, days from J2000.
+    d = (epoch - calendar.timegm((2000, 1, 1, 12, 0, 0))) / 86400.0
+    s = 218.3165 + 13.17639648 * d
+    h = 280.4661 + 0.98564736 * d
+    p = 83.3535 + 0.11140353 * d
+    n = 125.0445 - 0.05295377 * d
+    return s, h, p, n
+
+def nodal(name, n):
+    # Nodal factor f and correction u (degrees), after Pugh's tables.
+    r = math.radians(n)
+    m2 = (1.0004 - 0.0373 * math.cos(r) + 0.0002 * math.cos(2 * r), -2.14 * math.sin(r))
+    o1 = (1.0089 + 0.1871 * math.cos(r) - 0.0147 * math.cos(2 * r) + 0.0014 * math.cos(3 * r),
+          10.80 * math.sin(r) - 1.34 * math.sin(2 * r) + 0.19 * math.sin(3 * r))
+    if name in ('M2', 'N2'):
+        return m2
+    if name in ('O1', 'Q1'):
+        return o1
+    if name == 'K1':
+        return (1.0060 + 0.1150 * math.cos(r) - 0.0088 * math.cos(2 * r) + 0.0006 * math.cos(3 * r),
+                -8.86 * math.sin(r) + 0.68 * math.sin(2 * r) - 0.07 * math.sin(3 * r))
+    if name == 'K2':
+        return (1.0241 + 0.2863 * math.cos(r) + 0.0083 * math.cos(2 * r) - 0.0015 * math.cos(3 * r),
+                -17.74 * math.sin(r) + 0.68 * math.sin(2 * r) - 0.04 * math.sin(3 * r))
+    if name == 'M4':
+        return (m2[0] ** 2, 2 * m2[1])
+    if name == 'MS4':
+        return m2
+    return (1.0, 0.0)
+
+def turns(degrees):
+    return int(round((degrees % 360.0) / 360.0 * 2 ** 32)) % 2 ** 32
+
+def encode_station(station, epoch):
+    s, h, p, n = longitudes(epoch)
+    arguments = (180.0, s, h, p)  # T is 180 degrees at midnight
+    constituents = station['constituents']
+    if len(constituents) > MAX_CONSTITUENTS:
+        sys.exit('{}: more than {} constituents'.format(station['name'], MAX_CONSTITUENTS))
+
+    body = b''
+    for name, (amplitude, lag) in sorted(constituents.items(), key=lambda c: -c[1][0]):
+        if name not in CONSTITUENTS:
+            sys.exit('{}: unknown constituent {}'.format(station['name'], name))
+        multiples, offset = CONSTITUENTS[name]
+        f, u = nodal(name, n)
+        v0 = sum(m * a for m, a in zip(multiples, arguments)) + offset
+        rate = int(round(speed(name) / (360.0 * 3600.0) * 2 ** (32 + RATE_SHIFT)))
+        body += CONSTITUENT.pack(rate, turns(v0 + u - lag), int(round(f * amplitude * 1000)))
+    body += b'\0' * (CONSTITUENT.size * (MAX_CONSTITUENTS - len(constituents)))
+
+    name = station['name'].encode('ascii')[:NAME_SIZE - 1]
+    datum = int(round(station['datum'] * 1000))
+    return RECORD.pack(name, epoch, datum, len(constituents)) + body
+
+def main(source, target):
+    with open(source) as f:
+        config = json.load(f)
+    epoch = calendar.timegm((config['epoch_year'], 1, 1, 0, 0, 0))
+    stations = config['stations']
+    data = HEADER.pack(b'TIDE', VERSION, len(stations), RECORD_SIZE)
+    for station in stations:
+        data += encode_station(station, epoch)
+    with open(target, 'wb') as f:
+        f.write(data)
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit('usage: {} STATIONS.json OUTPUT.bin'.format(sys.argv[0]))
+    main(sys.argv[1], sys.argv[2])
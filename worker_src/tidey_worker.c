@@ -0,0 +1,56 @@
+#include <pebble_worker.h>
+#include "../src/worker_protocol.h"
+
+// Keeps the latest weather while other apps are in the foreground, so the
+// face can show it the moment it launches instead of waiting on the phone.
+
+static WeatherSnapshot s_snapshot;
+static WeatherSnapshot s_staging;
+static bool s_dirty = false;
+
+static void handle_app_message(uint16_t type, AppWorkerMessage *data) {
+  if (type == WORKER_MSG_REQUEST_SNAPSHOT) {
+    weather_snapshot_send(&s_snapshot);
+    return;
+  }
+  if (type == WORKER_MSG_SNAPSHOT_TOUCH) {
+    // The phone confirmed the weather without anything changing.
+    s_snapshot.fetched_at = data->data0 | ((uint32_t) data->data1 << 16);
+    s_dirty = true;
+    return;
+  }
+
+  switch (weather_snapshot_receive(&s_staging, type, data)) {
+    case SnapshotComplete:
+      s_snapshot = s_staging;
+      s_dirty = true;
+      break;
+    case SnapshotCorrupt:
+      APP_LOG(APP_LOG_LEVEL_WARNING, "dropped corrupt snapshot from app");
+      break;
+    default:
+      break;
+  }
+}
+
+static void do_init(void) {
+  memset(&s_snapshot, 0, sizeof(s_snapshot));
+  if (persist_read_data(WORKER_SNAPSHOT_PERSIST_KEY, &s_snapshot, sizeof(s_snapshot)) != sizeof(s_snapshot)) {
+    memset(&s_snapshot, 0, sizeof(s_snapshot));
+  }
+  app_worker_message_subscribe(handle_app_message);
+}
+
+static void do_deinit(void) {
+  app_worker_message_unsubscribe();
+  // Only written on the way out so a watch reboot doesn't lose it.
+  if (s_dirty) {
+    persist_write_data(WORKER_SNAPSHOT_PERSIST_KEY, &s_snapshot, sizeof(s_snapshot));
+  }
+}
+
+int main(void) {
+  do_init();
+  worker_event_loop();
+  do_deinit();
+}